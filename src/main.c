@@ -9,6 +9,8 @@
 
 #include "scenes/starting_scene.h"
 #include "scenes/gpio_test_scene.h"
+#include "utils/led_benchmark.h"
+#include "views/led_preview_view.h"
 
 // All scene on enter handlers - in the same order as their enum
 void (*const scene_on_enter_handlers[])(void*) = {
@@ -47,6 +49,11 @@ int setupViews(AppContext_t** appContext) {
     variableItemListView->viewId = LightUpViews_VariableListView;
     variableItemListView->type = VARIABLE_ITEM_LIST;
 
+    View_t* previewView = malloc(sizeof(View_t));
+    previewView->viewData = ledPreviewViewAlloc();
+    previewView->viewId = LightUpViews_PreviewView;
+    previewView->type = VIEW;
+
     // Add views to the app context to be managed there
     FURI_LOG_I(TAG, "Adding views to app context");
     AppContextStatus result = addViewToAppContext(appContext, menuView);
@@ -61,6 +68,12 @@ int setupViews(AppContext_t** appContext) {
         return -1;
     }
 
+    result = addViewToAppContext(appContext, previewView);
+    if(result != APP_CONTEXT_OK) {
+        FURI_LOG_E(TAG, "There was a problem adding the view %d!", previewView->viewId);
+        return -1;
+    }
+
     return 0;
 }
 
@@ -69,6 +82,10 @@ int32_t main_entry(void* p) {
 
     FURI_LOG_I(TAG, "Starting the app...");
 
+#ifdef LIGHT_UP_BENCHMARK
+    ledRunEncodeBenchmark();
+#endif
+
     AppContext_t* appContext;
     AppContextStatus result =
         initializeAppContext(&appContext, LightUpViews_count, &scene_event_handlers);
@@ -79,7 +96,13 @@ int32_t main_entry(void* p) {
         ((LightUpData_t*)appContext->additionalData)->gpioPin = &gpio_ext_pa7;
         ((LightUpData_t*)appContext->additionalData)->gpioTestPinStatus = false;
         ((LightUpData_t*)appContext->additionalData)->ledType = SingleLED;
+        ((LightUpData_t*)appContext->additionalData)->ledCountIndex = 2;
+        ((LightUpData_t*)appContext->additionalData)->ledCount = 10;
         ((LightUpData_t*)appContext->additionalData)->lightColorSelection = 0;
+        ((LightUpData_t*)appContext->additionalData)->brightnessIndex = 4;
+        ((LightUpData_t*)appContext->additionalData)->ledMode = LedModeSolid;
+        ((LightUpData_t*)appContext->additionalData)->keepAliveIndex = 0;
+        ((LightUpData_t*)appContext->additionalData)->ledWorker = NULL;
 
         result = setupViews(&appContext);
         if(result == 0) {
@@ -12,11 +12,21 @@ typedef enum {
     LedTypeSize,
 } LedType;
 
+typedef enum {
+    LedModeSolid = 0,
+    LedModeShow,
+    LedModePalette,
+    LedModeScript,
+    LedModeSprite,
+    LedModeSize,
+} LedMode;
+
 typedef enum { LightUpScenes_Starting, LightUpScenes_GPIOTest, LightUpScenes_count } LightUpScenes;
 
 typedef enum {
     LightUpViews_MenuView,
     LightUpViews_VariableListView,
+    LightUpViews_PreviewView,
     LightUpViews_count
 } LightUpViews;
 
@@ -27,5 +37,12 @@ typedef struct {
     int gpioPinIndex;
     const GpioPin* gpioPin;
     LedType ledType;
+    int ledCountIndex;
+    uint16_t ledCount;
     int lightColorSelection;
+    int brightnessIndex;
+    LedMode ledMode;
+    int keepAliveIndex;
+    // Drives the LEDs off of the GUI thread while a scene is using them.
+    struct LedWorker* ledWorker;
 } LightUpData_t;
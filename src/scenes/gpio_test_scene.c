@@ -1,10 +1,10 @@
 #include <gui/modules/variable_item_list.h>
 #include <furi_hal_gpio.h>
 #include <furi_hal_resources.h>
-#include <furi_hal_power.h>
 
 #include "gpio_test_scene.h"
-#include "../utils/gpio_helper.h"
+#include "../utils/led_worker.h"
+#include "../views/led_preview_view.h"
 #include "../app_context.h"
 #include "../main.h"
 
@@ -17,30 +17,43 @@ typedef enum {
     Blue = 0x0000ff,
 } LightColors;
 
+/// @brief Custom events sent to this scene from outside the GUI thread.
+typedef enum {
+    GpioTestEvent_RateChanged = 0x100,
+    GpioTestEvent_ShowPreview,
+    GpioTestEvent_EffectFailed,
+} GpioTestEvent;
+
+/// @brief The items in the list, in the order they are added.
+typedef enum {
+    GpioTestItem_PinStatus,
+    GpioTestItem_SelectedPin,
+    GpioTestItem_LedType,
+    GpioTestItem_LedCount,
+    GpioTestItem_Color,
+    GpioTestItem_Brightness,
+    GpioTestItem_Mode,
+    GpioTestItem_KeepAlive,
+    GpioTestItem_FrameRate,
+    GpioTestItem_Preview,
+} GpioTestItem;
+
 static LightColors gpio_light_color_options[] = {Red, Green, Blue};
+static const uint32_t gpio_keep_alive_options[] = {0, 1000, 10000};
+static const uint8_t gpio_brightness_options[] = {26, 64, 128, 191, 255};
 static void testLed(const LightUpData_t* lightUpData) {
-    switch(lightUpData->ledType) {
-    case SingleLED:
-        setGpioPin(lightUpData->gpioPin, lightUpData->gpioTestPinStatus);
-        break;
-    case WS8211:
-        if(lightUpData->gpioTestPinStatus) {
-            // furi_hal_power_enable_otg();
-            // sendRgbToWS8211(
-            //     lightUpData->gpioPin, gpio_light_color_options[lightUpData->lightColorSelection]);
-        }
-        break;
-    case WS2812B:
-        if(lightUpData->gpioTestPinStatus) {
-            furi_hal_power_enable_otg();
-            sendRgbToWS2812B(
-                lightUpData->gpioPin, gpio_light_color_options[lightUpData->lightColorSelection]);
-        }
-        break;
-    default:
-        FURI_LOG_E(TAG, "Error with selected LED type %d", lightUpData->ledType);
-        break;
-    }
+    // The worker owns the pins and OTG power, so just describe what we want.
+    LedCommand_t command = {
+        .gpioPin = lightUpData->gpioPin,
+        .ledType = lightUpData->ledType,
+        .ledCount = lightUpData->ledCount,
+        .ledMode = lightUpData->ledMode,
+        .enabled = lightUpData->gpioTestPinStatus,
+        .rgb = gpio_light_color_options[lightUpData->lightColorSelection],
+        .brightness = gpio_brightness_options[lightUpData->brightnessIndex],
+        .keepAliveMs = gpio_keep_alive_options[lightUpData->keepAliveIndex],
+    };
+    ledWorkerPost(lightUpData->ledWorker, &command);
 }
 
 static char* gpio_pin_status_names[] = {"Off", "On"};
@@ -49,10 +62,6 @@ static void gpio_pin_status_change(VariableItem* item) {
     LightUpData_t* lightUpData = ((LightUpData_t*)app->additionalData);
     uint8_t index = variable_item_get_current_value_index(item);
     variable_item_set_current_value_text(item, gpio_pin_status_names[index]);
-    // Turn the GPIO pin off first
-    setGpioPin(lightUpData->gpioPin, false);
-    // Always power cycle to clear the previous lights
-    furi_hal_power_disable_otg();
     lightUpData->gpioTestPinStatus = index;
     testLed(lightUpData);
 }
@@ -67,12 +76,58 @@ static void gpio_selected_pin_change(VariableItem* item) {
     lightUpData->gpioPinIndex = variable_item_get_current_value_index(item);
     variable_item_set_current_value_text(item, gpio_selected_pin_names[lightUpData->gpioPinIndex]);
 
-    // Turn the GPIO pin off first
-    setGpioPin(lightUpData->gpioPin, false);
     lightUpData->gpioPin = gpio_selected_pin_options[lightUpData->gpioPinIndex];
     testLed(lightUpData);
 }
 
+static const uint16_t gpio_led_count_options[] = {1, 5, 10, 30, 60, 100, 144, 300, 600, 1000};
+static VariableItem* gpio_led_count_item = NULL;
+static bool gpio_led_count_fits(const LightUpData_t* lightUpData, int index) {
+    return ledWorkerConfigFits(
+        lightUpData->ledWorker,
+        gpio_led_count_options[index],
+        lightUpData->ledType,
+        lightUpData->ledMode);
+}
+
+static void gpio_led_count_update(VariableItem* item, LightUpData_t* lightUpData) {
+    // Only switch to LED counts whose buffers fit in memory, otherwise fall back
+    // to the largest one that does, so the list always shows the applied count
+    int index = lightUpData->ledCountIndex;
+    while(index > 0 && !gpio_led_count_fits(lightUpData, index)) {
+        index--;
+    }
+    char text[16];
+    if(index != lightUpData->ledCountIndex) {
+        FURI_LOG_W(
+            TAG,
+            "Not enough memory for %u LEDs",
+            gpio_led_count_options[lightUpData->ledCountIndex]);
+        snprintf(text, sizeof(text), "%u (No RAM)", gpio_led_count_options[index]);
+    } else {
+        snprintf(text, sizeof(text), "%u", gpio_led_count_options[index]);
+    }
+    lightUpData->ledCountIndex = index;
+    lightUpData->ledCount = gpio_led_count_options[index];
+    variable_item_set_current_value_index(item, index);
+    variable_item_set_current_value_text(item, text);
+}
+
+static void gpio_led_count_change(VariableItem* item) {
+    AppContext_t* app = variable_item_get_context(item);
+    LightUpData_t* lightUpData = ((LightUpData_t*)app->additionalData);
+    lightUpData->ledCountIndex = variable_item_get_current_value_index(item);
+    gpio_led_count_update(item, lightUpData);
+    testLed(lightUpData);
+}
+
+static char* gpio_brightness_names[] = {"10%", "25%", "50%", "75%", "100%"};
+static VariableItem* gpio_brightness_item = NULL;
+static void gpio_brightness_update(VariableItem* item, LightUpData_t* lightUpData) {
+    // Only circuits are dimmed, strips get their brightness from the color
+    variable_item_set_locked(item, lightUpData->ledType != SingleLED, "Circuit LEDs only");
+}
+
 static char* gpio_pin_led_type_names[] = {"Circuit", "WS8211", "WS2812B"};
 static void gpio_pin_led_type_change(VariableItem* item) {
     AppContext_t* app = variable_item_get_context(item);
@@ -80,10 +135,9 @@ static void gpio_pin_led_type_change(VariableItem* item) {
     uint8_t index = variable_item_get_current_value_index(item);
     variable_item_set_current_value_text(item, gpio_pin_led_type_names[index]);
     lightUpData->ledType = index;
-    // Turn the GPIO pin off first
-    setGpioPin(lightUpData->gpioPin, false);
-    // Always power cycle to clear the previous lights
-    furi_hal_power_disable_otg();
+    // Different LED types need different buffers, so re-check the LED count
+    gpio_led_count_update(gpio_led_count_item, lightUpData);
+    gpio_brightness_update(gpio_brightness_item, lightUpData);
     testLed(lightUpData);
 }
 
@@ -94,16 +148,116 @@ static void gpio_light_color_change(VariableItem* item) {
     lightUpData->lightColorSelection = variable_item_get_current_value_index(item);
     variable_item_set_current_value_text(
         item, gpio_light_color_names[lightUpData->lightColorSelection]);
-    // Turn the GPIO pin off first
     testLed(lightUpData);
 }
 
+static void gpio_brightness_change(VariableItem* item) {
+    AppContext_t* app = variable_item_get_context(item);
+    LightUpData_t* lightUpData = ((LightUpData_t*)app->additionalData);
+    lightUpData->brightnessIndex = variable_item_get_current_value_index(item);
+    variable_item_set_current_value_text(
+        item, gpio_brightness_names[lightUpData->brightnessIndex]);
+    testLed(lightUpData);
+}
+
+static char* gpio_led_mode_names[] = {"Solid", "Show", "Palette", "Script", "Sprite"};
+static VariableItem* gpio_led_mode_item = NULL;
+static void gpio_led_mode_change(VariableItem* item) {
+    AppContext_t* app = variable_item_get_context(item);
+    LightUpData_t* lightUpData = ((LightUpData_t*)app->additionalData);
+    lightUpData->ledMode = variable_item_get_current_value_index(item);
+    variable_item_set_current_value_text(item, gpio_led_mode_names[lightUpData->ledMode]);
+    // Each mode stores its pixels differently, so re-check the LED count
+    gpio_led_count_update(gpio_led_count_item, lightUpData);
+    testLed(lightUpData);
+}
+
+static char* gpio_keep_alive_names[] = {"Off", "1s", "10s"};
+static void gpio_keep_alive_change(VariableItem* item) {
+    AppContext_t* app = variable_item_get_context(item);
+    LightUpData_t* lightUpData = ((LightUpData_t*)app->additionalData);
+    lightUpData->keepAliveIndex = variable_item_get_current_value_index(item);
+    variable_item_set_current_value_text(
+        item, gpio_keep_alive_names[lightUpData->keepAliveIndex]);
+    testLed(lightUpData);
+}
+
+// Written by the LED worker, read on the GUI thread once the event arrives
+static volatile LedWorkerError gpio_effect_error = LedWorkerErrorScriptLoad;
+static void gpio_effect_failed(LedWorkerError error, void* context) {
+    AppContext_t* app = context;
+    gpio_effect_error = error;
+    view_dispatcher_send_custom_event(app->view_dispatcher, GpioTestEvent_EffectFailed);
+}
+
+static void gpio_effect_error_update(VariableItem* item, const LightUpData_t* lightUpData) {
+    // The mode may have been changed since, in which case there is nothing to show
+    if(lightUpData->ledMode == LedModeScript) {
+        variable_item_set_current_value_text(
+            item, gpio_effect_error == LedWorkerErrorScriptLoad ? "No script" : "Script err");
+    }
+}
+
+// Written by the LED worker, read on the GUI thread once the event arrives
+static volatile uint32_t gpio_rate_fps = 0;
+static VariableItem* gpio_rate_item = NULL;
+static void gpio_rate_update(VariableItem* item) {
+    char text[16];
+    if(gpio_rate_fps == 0) {
+        snprintf(text, sizeof(text), "-");
+    } else {
+        snprintf(text, sizeof(text), "%lu fps", gpio_rate_fps);
+    }
+    variable_item_set_current_value_text(item, text);
+}
+
+static void gpio_rate_changed(uint32_t fps, void* context) {
+    AppContext_t* app = context;
+    gpio_rate_fps = fps;
+    view_dispatcher_send_custom_event(app->view_dispatcher, GpioTestEvent_RateChanged);
+}
+
+static void gpio_item_enter(void* context, uint32_t index) {
+    AppContext_t* app = context;
+    if(index == GpioTestItem_Preview) {
+        view_dispatcher_send_custom_event(app->view_dispatcher, GpioTestEvent_ShowPreview);
+    }
+}
+
+static void gpio_preview_shown(bool shown, void* context) {
+    AppContext_t* app = context;
+    LightUpData_t* lightUpData = app->additionalData;
+    if(lightUpData->ledWorker == NULL) {
+        return;
+    }
+    // Only publish while the preview can be seen, so a hidden one costs the worker nothing
+    View* previewView = app->activeViews[LightUpViews_PreviewView]->viewData;
+    ledWorkerSetPreview(
+        lightUpData->ledWorker, shown ? ledPreviewViewGetPreview(previewView) : NULL);
+}
+
+static uint32_t gpio_preview_previous(void* context) {
+    UNUSED(context);
+    return LightUpViews_VariableListView;
+}
+
 /** resets the menu, gives it content, callbacks and selection enums */
 void scene_on_enter_gpio_test_scene(void* context) {
     FURI_LOG_I(TAG, "scene_on_enter_gpio_test_scene");
     AppContext_t* app = (AppContext_t*)context;
     View_t* variableItemListView = app->activeViews[LightUpViews_VariableListView];
 
+    // Start the worker that will drive the LEDs for this scene
+    ((LightUpData_t*)app->additionalData)->ledWorker = ledWorkerAlloc();
+    View* previewView = app->activeViews[LightUpViews_PreviewView]->viewData;
+    ledPreviewViewSetShownCallback(previewView, gpio_preview_shown, app);
+    view_set_previous_callback(previewView, gpio_preview_previous);
+    gpio_rate_fps = 0;
+    ledWorkerSetRateCallback(
+        ((LightUpData_t*)app->additionalData)->ledWorker, gpio_rate_changed, app);
+    ledWorkerSetErrorCallback(
+        ((LightUpData_t*)app->additionalData)->ledWorker, gpio_effect_failed, app);
+
     // Add status options
     variable_item_list_reset(variableItemListView->viewData);
 
@@ -131,6 +285,18 @@ void scene_on_enter_gpio_test_scene(void* context) {
     variable_item_set_current_value_text(
         item, gpio_pin_led_type_names[((LightUpData_t*)app->additionalData)->ledType]);
 
+    // Add LED count options
+    gpio_led_count_item = variable_item_list_add(
+        variableItemListView->viewData,
+        "LED Count",
+        COUNT_OF(gpio_led_count_options),
+        gpio_led_count_change,
+        app);
+
+    variable_item_set_current_value_index(
+        gpio_led_count_item, ((LightUpData_t*)app->additionalData)->ledCountIndex);
+    gpio_led_count_update(gpio_led_count_item, (LightUpData_t*)app->additionalData);
+
     // Add light color for where available
     item = variable_item_list_add(
         app->activeViews[LightUpViews_VariableListView]->viewData,
@@ -144,6 +310,57 @@ void scene_on_enter_gpio_test_scene(void* context) {
     variable_item_set_current_value_text(
         item, gpio_light_color_names[((LightUpData_t*)app->additionalData)->lightColorSelection]);
 
+    // Add brightness options, used to dim circuits
+    gpio_brightness_item = variable_item_list_add(
+        variableItemListView->viewData,
+        "Brightness",
+        COUNT_OF(gpio_brightness_names),
+        gpio_brightness_change,
+        app);
+
+    variable_item_set_current_value_index(
+        gpio_brightness_item, ((LightUpData_t*)app->additionalData)->brightnessIndex);
+    variable_item_set_current_value_text(
+        gpio_brightness_item,
+        gpio_brightness_names[((LightUpData_t*)app->additionalData)->brightnessIndex]);
+    gpio_brightness_update(gpio_brightness_item, (LightUpData_t*)app->additionalData);
+
+    // Add mode options, shows play a timeline built from the color,
+    // palette mode rotates a palette ramping from it, script mode runs
+    // an effect loaded from the SD card and sprite mode scrolls the
+    // built in sprites across the strip laid out as a matrix
+    gpio_led_mode_item = variable_item_list_add(
+        variableItemListView->viewData, "Mode", LedModeSize, gpio_led_mode_change, app);
+
+    variable_item_set_current_value_index(
+        gpio_led_mode_item, ((LightUpData_t*)app->additionalData)->ledMode);
+    variable_item_set_current_value_text(
+        gpio_led_mode_item, gpio_led_mode_names[((LightUpData_t*)app->additionalData)->ledMode]);
+
+    // Add keep alive options, by default frames are only sent when they change
+    item = variable_item_list_add(
+        variableItemListView->viewData,
+        "Keep Alive",
+        COUNT_OF(gpio_keep_alive_names),
+        gpio_keep_alive_change,
+        app);
+
+    variable_item_set_current_value_index(
+        item, ((LightUpData_t*)app->additionalData)->keepAliveIndex);
+    variable_item_set_current_value_text(
+        item, gpio_keep_alive_names[((LightUpData_t*)app->additionalData)->keepAliveIndex]);
+
+    // Show the rate effects are running at, the worker lowers it when frames take too long
+    gpio_rate_item =
+        variable_item_list_add(variableItemListView->viewData, "Frame Rate", 1, NULL, app);
+    gpio_rate_update(gpio_rate_item);
+
+    // Add the preview, pressing OK shows what the strip should currently look like
+    item = variable_item_list_add(variableItemListView->viewData, "Preview", 1, NULL, app);
+    variable_item_set_current_value_text(item, "OK");
+    variable_item_list_set_enter_callback(
+        variableItemListView->viewData, gpio_item_enter, app);
+
     // Set the currently active view
     FURI_LOG_I(TAG, "setting active view");
     view_dispatcher_switch_to_view(app->view_dispatcher, LightUpViews_VariableListView);
@@ -152,9 +369,25 @@ void scene_on_enter_gpio_test_scene(void* context) {
 /** main menu event handler - switches scene based on the event */
 bool scene_on_event_gpio_test_scene(void* context, SceneManagerEvent event) {
     FURI_LOG_I(TAG, "scene_on_event_gpio_test_scene");
-    UNUSED(context);
-    UNUSED(event);
-    return false;
+    AppContext_t* app = context;
+    bool consumed = false;
+    switch(event.type) {
+    case SceneManagerEventTypeCustom:
+        if(event.event == GpioTestEvent_RateChanged && gpio_rate_item != NULL) {
+            gpio_rate_update(gpio_rate_item);
+            consumed = true;
+        } else if(event.event == GpioTestEvent_EffectFailed && gpio_led_mode_item != NULL) {
+            gpio_effect_error_update(gpio_led_mode_item, app->additionalData);
+            consumed = true;
+        } else if(event.event == GpioTestEvent_ShowPreview) {
+            view_dispatcher_switch_to_view(app->view_dispatcher, LightUpViews_PreviewView);
+            consumed = true;
+        }
+        break;
+    default:
+        break;
+    }
+    return consumed;
 }
 
 void scene_on_exit_gpio_test_scene(void* context) {
@@ -162,6 +395,14 @@ void scene_on_exit_gpio_test_scene(void* context) {
     AppContext_t* app = (AppContext_t*)context;
     LightUpData_t* lightUpData = ((LightUpData_t*)app->additionalData);
     lightUpData->gpioTestPinStatus = false;
-    setGpioPin(lightUpData->gpioPin, false);
-    furi_hal_power_disable_otg();
+    ledPreviewViewSetShownCallback(
+        app->activeViews[LightUpViews_PreviewView]->viewData, NULL, NULL);
+    // Freeing the worker also turns off the pin and OTG power it was using
+    ledWorkerFree(lightUpData->ledWorker);
+    // The worker has stopped, so no more rate events can be sent
+    lightUpData->ledWorker = NULL;
+    gpio_led_count_item = NULL;
+    gpio_brightness_item = NULL;
+    gpio_led_mode_item = NULL;
+    gpio_rate_item = NULL;
 }
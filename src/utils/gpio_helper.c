@@ -5,7 +5,7 @@
 #include "../main.h"
 
 // We store the HIGH/LOW durations (2 values) for each color bit (24 bits per LED)
-#define LED_DRIVER_BUFFER_SIZE (MAX_LED_COUNT * 2 * 24)
+#define LED_DRIVER_BUFFER_SIZE(ledCount) ((size_t)(ledCount) * 2 * 24)
 // We use a setinel value to figure out when the timer is complete.
 #define LED_DRIVER_TIMER_SETINEL 0xFFFFU
 
@@ -18,11 +18,12 @@
 #define LED_DRIVER_T1L 450U
 #define LED_DRIVER_TRESETL 55 * 1000U
 
-// Wait for 35ms for the DMA to complete. NOTE: 1000 leds*(850ns+450ns)*24 = 32ms
-#define LED_DRIVER_SETINEL_WAIT_MS 35
+// Wait for the DMA to complete, plus some slack. NOTE: 1000 leds*(850ns+450ns)*24 = 32ms
+#define LED_DRIVER_SETINEL_WAIT_MS(ledCount) \
+    ((uint32_t)(ledCount) * 24 * (LED_DRIVER_T0L + LED_DRIVER_T1L) / (1000U * 1000U) + 3)
 
 void setGpioPin(const GpioPin* gpioPin, bool state) {
-    FURI_LOG_I(TAG, "Updating pin state to %s", state ? "On" : "Off");
+    FURI_LOG_D(TAG, "Updating pin state to %s", state ? "On" : "Off");
     if(state) {
         furi_hal_gpio_init_simple(gpioPin, GpioModeOutputPushPull);
     } else {
@@ -53,8 +54,10 @@ static void setupDMAGPIOUpdate(
     dma_gpio_update->Priority = LL_DMA_PRIORITY_VERYHIGH;
 }
 
-static void
-    setupDMATransitionTimer(LL_DMA_InitTypeDef* dma_transition_timer, uint16_t* timerBuffer) {
+static void setupDMATransitionTimer(
+    LL_DMA_InitTypeDef* dma_transition_timer,
+    uint16_t* timerBuffer,
+    size_t timerBufferLength) {
     // Timer that triggers based on user data.
     dma_transition_timer->Direction = LL_DMA_DIRECTION_MEMORY_TO_PERIPH;
     // Peripheral (Timer - We populate TIM2's ARR register)
@@ -67,7 +70,7 @@ static void
     dma_transition_timer->MemoryOrM2MDstDataSize = LL_DMA_MDATAALIGN_HALFWORD;
     // Data
     dma_transition_timer->Mode = LL_DMA_MODE_NORMAL;
-    dma_transition_timer->NbData = LED_DRIVER_BUFFER_SIZE;
+    dma_transition_timer->NbData = timerBufferLength;
     // When to perform data exchange
     dma_transition_timer->PeriphRequest = LL_DMAMUX_REQ_TIM2_UP;
     dma_transition_timer->Priority = LL_DMA_PRIORITY_HIGH;
@@ -113,9 +116,9 @@ static void led_driver_stop_dma() {
     LL_DMA_ClearFlag_TC2(DMA1);
 }
 
-static void led_driver_spin_lock(uint32_t* write_pos) {
+static void led_driver_spin_lock(uint32_t* write_pos, uint32_t wait_ms) {
     const uint32_t prev_timer = DWT->CYCCNT;
-    const uint32_t wait_time = LED_DRIVER_SETINEL_WAIT_MS * SystemCoreClock / 1000;
+    const uint32_t wait_time = wait_ms * (SystemCoreClock / 1000);
     uint32_t read_pos = 0;
 
     do {
@@ -133,14 +136,15 @@ static void led_driver_spin_lock(uint32_t* write_pos) {
     } while(true);
 }
 
-static void
-    led_driver_add_period_length(uint16_t* timer_buffer, uint32_t* write_pos, uint32_t length) {
-    timer_buffer[(*write_pos)++] = length;
-    timer_buffer[*write_pos] = LED_DRIVER_TIMER_SETINEL;
-}
+/// @brief Timer reload values for both halves of a 1 bit and a 0 bit, worked out once per frame.
+typedef struct {
+    uint16_t setFirst;
+    uint16_t setSecond;
+    uint16_t clearFirst;
+    uint16_t clearSecond;
+} LedDriverPeriods;
 
-static void
-    led_driver_add_period(uint16_t* timer_buffer, uint32_t* write_pos, uint16_t duration_ns) {
+static uint16_t led_driver_period_length(uint16_t duration_ns) {
     uint32_t reload_value = duration_ns / LED_DRIVER_TIMER_NANOSECOND;
 
     if(reload_value > 255) {
@@ -149,11 +153,78 @@ static void
     furi_check(reload_value > 0);
     furi_check(reload_value < 256 * 256);
 
-    led_driver_add_period_length(timer_buffer, write_pos, reload_value - 1);
+    return reload_value - 1;
+}
+
+static inline void led_driver_add_color(
+    uint16_t* timer_buffer,
+    uint32_t* write_pos,
+    const LedDriverPeriods* periods,
+    uint32_t ggrrbb) {
+    uint16_t* period = &timer_buffer[*write_pos];
+    for(int i = 23; i >= 0; i--) {
+        if(ggrrbb & (1 << i)) {
+            *period++ = periods->setFirst;
+            *period++ = periods->setSecond;
+        } else {
+            *period++ = periods->clearFirst;
+            *period++ = periods->clearSecond;
+        }
+    }
+    *write_pos += 2 * 24;
+}
+
+size_t ws2812bTimerBufferLength(uint16_t ledCount) {
+    // Room for the trailing sentinel value as well
+    return LED_DRIVER_BUFFER_SIZE(ledCount) + 2;
 }
 
-void sendRgbToWS2812B(const GpioPin* gpioPin, uint32_t rgb) {
-    FURI_LOG_I(TAG, "Setting WS2812B color to %04x", (unsigned int)rgb);
+uint32_t ws2812bEncode(const LedFramebuffer_t* framebuffer, uint16_t* timerBuffer) {
+    const LedDriverPeriods periods = {
+        .setFirst = led_driver_period_length(LED_DRIVER_T0H),
+        .setSecond = led_driver_period_length(LED_DRIVER_T1H),
+        .clearFirst = led_driver_period_length(LED_DRIVER_T0L),
+        .clearSecond = led_driver_period_length(LED_DRIVER_T1L),
+    };
+
+    // Palette entries are already in GRB order, so they are expanded right
+    // into the timer buffer without an intermediate full color frame.
+    uint32_t write_pos = 0;
+    const uint8_t* pixels = framebuffer->pixels;
+    const uint32_t* palette = framebuffer->palette;
+    switch(framebuffer->format) {
+    case LedPixelFormatIndexed4:
+        for(uint16_t j = 0; j < framebuffer->count; j++) {
+            const uint8_t entry = (pixels[j / 2] >> ((j & 1) * 4)) & 0x0F;
+            led_driver_add_color(timerBuffer, &write_pos, &periods, palette[entry]);
+        }
+        break;
+    case LedPixelFormatIndexed8:
+        for(uint16_t j = 0; j < framebuffer->count; j++) {
+            led_driver_add_color(timerBuffer, &write_pos, &periods, palette[pixels[j]]);
+        }
+        break;
+    default:
+        for(uint16_t j = 0; j < framebuffer->count; j++) {
+            const uint8_t* rgb = &pixels[j * LED_FRAMEBUFFER_BYTES_PER_LED];
+            uint32_t ggrrbb = ((uint32_t)rgb[1] << 16) | ((uint32_t)rgb[0] << 8) | rgb[2];
+            led_driver_add_color(timerBuffer, &write_pos, &periods, ggrrbb);
+        }
+        break;
+    }
+    // The sentinel marks the end of the frame for the spin lock
+    timerBuffer[write_pos] = LED_DRIVER_TIMER_SETINEL;
+    return write_pos;
+}
+
+void sendFrameToWS2812B(
+    const GpioPin* gpioPin,
+    const LedFramebuffer_t* framebuffer,
+    uint16_t* timerBuffer,
+    LedFrameTiming_t* timing) {
+    FURI_LOG_D(TAG, "Sending %u LEDs to WS2812B", framebuffer->count);
+    const uint32_t cyclesPerUs = SystemCoreClock / 1000000U;
+    const uint32_t encodeStart = DWT->CYCCNT;
 
     LL_DMA_InitTypeDef dma_gpio_update;
     LL_DMA_InitTypeDef dma_transition_timer;
@@ -162,62 +233,33 @@ void sendRgbToWS2812B(const GpioPin* gpioPin, uint32_t rgb) {
     const uint32_t bit_set = gpioPin->pin << GPIO_BSRR_BS0_Pos;
     const uint32_t bit_reset = gpioPin->pin << GPIO_BSRR_BR0_Pos;
     uint32_t gpio_buf[2] = {bit_reset, bit_set};
-    FURI_LOG_I(TAG, "Setting up GPIO update");
     setupDMAGPIOUpdate(&dma_gpio_update, gpioPin, gpio_buf);
-
-    uint16_t timer_buffer[LED_DRIVER_BUFFER_SIZE + 2];
-    FURI_LOG_I(TAG, "Setting up transition timer");
-    setupDMATransitionTimer(&dma_transition_timer, timer_buffer);
+    setupDMATransitionTimer(
+        &dma_transition_timer, timerBuffer, ws2812bTimerBufferLength(framebuffer->count));
 
     furi_hal_gpio_init(gpioPin, GpioModeOutputPushPull, GpioPullNo, GpioSpeedVeryHigh);
     furi_hal_gpio_write(gpioPin, false);
 
-    // Setup the transition timer
-    FURI_LOG_I(TAG, "Populating timer buffer with empty");
-    for(size_t i = 0; i < LED_DRIVER_BUFFER_SIZE; i++) {
-        timer_buffer[i] = LED_DRIVER_TIMER_SETINEL;
-    }
-    FURI_LOG_I(TAG, "Done");
-
-    // Add colors here
-    uint32_t write_pos = 0;
-    FURI_LOG_I(TAG, "Actually setting color");
-    for(int j = 0; j < MAX_LED_COUNT; j++) {
-        uint32_t ggrrbb = (rgb & 0xFF) | ((rgb & 0xFF00) << 8) | ((rgb & 0xFF0000) >> 8);
-        for(int i = 23; i >= 0; i--) {
-            FURI_LOG_I(TAG, "Color %d", i);
-            if(ggrrbb & (1 << i)) {
-                led_driver_add_period(timer_buffer, &write_pos, LED_DRIVER_T0H);
-                led_driver_add_period(timer_buffer, &write_pos, LED_DRIVER_T1H);
-            } else {
-                led_driver_add_period(timer_buffer, &write_pos, LED_DRIVER_T0L);
-                led_driver_add_period(timer_buffer, &write_pos, LED_DRIVER_T1L);
-            }
-        }
-    }
-    FURI_LOG_I(TAG, "Done");
+    uint32_t write_pos = ws2812bEncode(framebuffer, timerBuffer);
 
     // Number of bits written
     dma_transition_timer.NbData = write_pos + 1;
 
+    const uint32_t transmitStart = DWT->CYCCNT;
     FURI_CRITICAL_ENTER();
 
-    FURI_LOG_I(TAG, "Starting the DMA");
     led_driver_start_dma(&dma_gpio_update, &dma_transition_timer);
-    FURI_LOG_I(TAG, "Starting the timers");
     led_driver_start_timer();
 
-    FURI_LOG_I(TAG, "Entering spin lock");
-    led_driver_spin_lock(&write_pos);
-    FURI_LOG_I(TAG, "Exiting spin lock");
+    led_driver_spin_lock(&write_pos, LED_DRIVER_SETINEL_WAIT_MS(framebuffer->count));
 
-    FURI_LOG_I(TAG, "Stopping timer");
     led_driver_stop_timer();
-    FURI_LOG_I(TAG, "Stopping DMA");
     led_driver_stop_dma();
 
     FURI_CRITICAL_EXIT();
 
-    FURI_LOG_I(TAG, "Clearing timer buffer");
-    memset(timer_buffer, LED_DRIVER_TIMER_SETINEL, LED_DRIVER_BUFFER_SIZE);
+    if(timing != NULL) {
+        timing->encodeUs = (transmitStart - encodeStart) / cyclesPerUs;
+        timing->transmitUs = (DWT->CYCCNT - transmitStart) / cyclesPerUs;
+    }
 }
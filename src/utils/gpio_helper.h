@@ -2,7 +2,29 @@
 
 #include <furi_hal_gpio.h>
 
-#define MAX_LED_COUNT 10
+#include "led_framebuffer.h"
+#include "led_governor.h"
 
 void setGpioPin(const GpioPin* gpioPin, bool state);
-void sendRgbToWS2812B(const GpioPin* gpioPin, uint32_t rgb);
+
+/// @brief Gets the number of timer buffer entries needed to send a WS2812B frame.
+/// @param ledCount The number of LEDs on the strip.
+/// @return The number of 16 bit entries the timer buffer must hold.
+size_t ws2812bTimerBufferLength(uint16_t ledCount);
+
+/// @brief Encodes a frame into the timer periods used to send it to a WS2812B strip.
+/// @param framebuffer The colors to encode, one per LED.
+/// @param timerBuffer Scratch space of at least ws2812bTimerBufferLength entries.
+/// @return The number of periods written, not counting the trailing sentinel.
+uint32_t ws2812bEncode(const LedFramebuffer_t* framebuffer, uint16_t* timerBuffer);
+
+/// @brief Encodes and sends a frame to a WS2812B strip.
+/// @param gpioPin The pin the strip's data line is connected to.
+/// @param framebuffer The colors to send, one per LED.
+/// @param timerBuffer Scratch space of at least ws2812bTimerBufferLength entries.
+/// @param timing If not NULL, set to how long encoding and sending the frame took.
+void sendFrameToWS2812B(
+    const GpioPin* gpioPin,
+    const LedFramebuffer_t* framebuffer,
+    uint16_t* timerBuffer,
+    LedFrameTiming_t* timing);
@@ -0,0 +1,71 @@
+#include <furi.h>
+
+#include "led_arena.h"
+#include "../main.h"
+
+// Leave some room on the heap so that the GUI and the rest of the system
+// can keep working when the arena is as large as possible.
+#define LED_ARENA_HEAP_RESERVE (8 * 1024)
+
+size_t ledArenaAlignSize(size_t size) {
+    return (size + LED_ARENA_ALIGNMENT - 1) & ~((size_t)LED_ARENA_ALIGNMENT - 1);
+}
+
+bool ledArenaFits(size_t size, size_t reclaimable) {
+    // The reclaimable block and the largest free one are not next to each
+    // other, so only one of them can be counted on to hold the arena
+    size_t available = MAX(memmgr_heap_get_max_free_block(), reclaimable);
+    return size + LED_ARENA_HEAP_RESERVE <= available;
+}
+
+LedArenaStatus ledArenaInit(LedArena_t* arena, size_t capacity) {
+    if(arena->base != NULL) {
+        return LED_ARENA_ALREADY_INITIALIZED;
+    }
+    capacity = ledArenaAlignSize(capacity);
+    if(!ledArenaFits(capacity, 0)) {
+        FURI_LOG_E(TAG, "Not enough memory for a %u byte LED arena", (unsigned int)capacity);
+        return LED_ARENA_CANT_ALLOCATE;
+    }
+
+    // The heap already hands out blocks aligned well past LED_ARENA_ALIGNMENT
+    FURI_LOG_D(TAG, "Allocating %u byte LED arena", (unsigned int)capacity);
+    arena->base = malloc(capacity);
+    if(arena->base == NULL) {
+        return LED_ARENA_CANT_ALLOCATE;
+    }
+    arena->capacity = capacity;
+    arena->used = 0;
+    return LED_ARENA_OK;
+}
+
+void* ledArenaAlloc(LedArena_t* arena, size_t size) {
+    size = ledArenaAlignSize(size);
+    if(arena->base == NULL || size > arena->capacity - arena->used) {
+        FURI_LOG_E(TAG, "LED arena out of memory (%u bytes requested)", (unsigned int)size);
+        return NULL;
+    }
+    void* block = arena->base + arena->used;
+    arena->used += size;
+    return block;
+}
+
+bool ledArenaSplit(LedArena_t* arena, LedArena_t* child, size_t size) {
+    child->base = ledArenaAlloc(arena, size);
+    child->capacity = child->base != NULL ? ledArenaAlignSize(size) : 0;
+    child->used = 0;
+    return child->base != NULL;
+}
+
+void ledArenaReset(LedArena_t* arena) {
+    arena->used = 0;
+}
+
+void ledArenaFree(LedArena_t* arena) {
+    if(arena->base != NULL) {
+        free(arena->base);
+    }
+    arena->base = NULL;
+    arena->capacity = 0;
+    arena->used = 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/// @brief All allocations handed out by the arena are aligned to this many
+/// bytes, which is enough for word sized DMA transfers.
+#define LED_ARENA_ALIGNMENT 4
+
+/// @brief An enum to define different result statuses for functions
+/// regarding the LED arena.
+typedef enum {
+    LED_ARENA_OK = 0,
+    LED_ARENA_CANT_ALLOCATE = -1,
+    LED_ARENA_ALREADY_INITIALIZED = -2,
+} LedArenaStatus;
+
+/// @brief A single block of memory that every LED buffer is carved out of.
+/// Allocations are bumped off of the front and can only be released all at once.
+typedef struct {
+    uint8_t* base;
+    size_t capacity;
+    size_t used;
+} LedArena_t;
+
+/// @brief Rounds a size up so that the next allocation stays aligned.
+/// @param size The size in bytes to round up.
+/// @return The aligned size in bytes.
+size_t ledArenaAlignSize(size_t size);
+
+/// @brief Checks whether an arena of the given size can currently be allocated.
+/// @param size The total size in bytes of the arena.
+/// @param reclaimable The size in bytes of a block freed before the arena is allocated.
+/// @return Returns true if there is, or will be, a large enough free block on the heap.
+bool ledArenaFits(size_t size, size_t reclaimable);
+
+/// @brief Allocates the memory backing the arena. This is the only heap allocation it makes.
+/// @param arena The arena to initialize.
+/// @param capacity The total size in bytes of the arena.
+/// @return Returns LED_ARENA_OK on success, LED_ARENA_CANT_ALLOCATE if there is not enough memory.
+LedArenaStatus ledArenaInit(LedArena_t* arena, size_t capacity);
+
+/// @brief Hands out the next aligned block from the arena.
+/// @param arena The arena to allocate from.
+/// @param size The size in bytes of the block.
+/// @return The block, or NULL if the arena does not have enough room left.
+void* ledArenaAlloc(LedArena_t* arena, size_t size);
+
+/// @brief Hands out a block from the arena as an arena of its own, so that it
+/// can be reset without touching the rest. Must not be passed to ledArenaFree.
+/// @param arena The arena to allocate from.
+/// @param child The arena to set up over the new block.
+/// @param size The size in bytes of the block.
+/// @return Returns true on success, false if the arena does not have enough room left.
+bool ledArenaSplit(LedArena_t* arena, LedArena_t* child, size_t size);
+
+/// @brief Releases every block handed out so far while keeping the backing memory.
+/// @param arena The arena to reset.
+void ledArenaReset(LedArena_t* arena);
+
+/// @brief Frees the backing memory of the arena, invalidating every block from it.
+/// @param arena The arena to free.
+void ledArenaFree(LedArena_t* arena);
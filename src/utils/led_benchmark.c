@@ -0,0 +1,200 @@
+#ifdef LIGHT_UP_BENCHMARK
+
+#include <furi.h>
+#include <furi_hal.h>
+
+#include "led_benchmark.h"
+#include "led_arena.h"
+#include "led_framebuffer.h"
+#include "led_vm.h"
+#include "gpio_helper.h"
+#include "../main.h"
+
+#define LED_BENCHMARK_LED_COUNT 300
+#define LED_BENCHMARK_ITERATIONS 20
+
+typedef struct {
+    const char* name;
+    LedPixelFormat format;
+} LedBenchmarkCase_t;
+
+static const LedBenchmarkCase_t led_benchmark_cases[] = {
+    {"RGB", LedPixelFormatRgb},
+    {"Indexed8", LedPixelFormatIndexed8},
+    {"Indexed4", LedPixelFormatIndexed4},
+};
+
+static void led_benchmark_fill(LedFramebuffer_t* framebuffer) {
+    for(uint16_t i = 0; i < framebuffer->paletteSize; i++) {
+        ledFramebufferSetPaletteEntry(framebuffer, i, i * 0x010203);
+    }
+    for(uint16_t i = 0; i < framebuffer->count; i++) {
+        if(framebuffer->format == LedPixelFormatRgb) {
+            ledFramebufferSetPixel(framebuffer, i, i * 0x010203);
+        } else {
+            ledFramebufferSetIndex(framebuffer, i, i % framebuffer->paletteSize);
+        }
+    }
+}
+
+/// @brief Animates the framebuffer by one step the cheapest way its format allows.
+static void led_benchmark_animate(LedFramebuffer_t* framebuffer) {
+    if(framebuffer->format == LedPixelFormatRgb) {
+        // Without a palette every pixel has to move
+        uint8_t first[LED_FRAMEBUFFER_BYTES_PER_LED];
+        const size_t size = ledFramebufferSize(framebuffer->format, framebuffer->count);
+        memcpy(first, framebuffer->pixels, sizeof(first));
+        memmove(
+            framebuffer->pixels,
+            framebuffer->pixels + sizeof(first),
+            size - sizeof(first));
+        memcpy(framebuffer->pixels + size - sizeof(first), first, sizeof(first));
+    } else {
+        ledFramebufferRotatePalette(framebuffer, 0, framebuffer->paletteSize);
+    }
+}
+
+// Compiled by tools/led_vm.py from:
+//     var t = time
+//     for i in 0 .. count {
+//         set(i, rgb(sin(t + i * 8), 0, 0))
+//     }
+static const uint8_t led_benchmark_vm_loop[] = {
+    0x4c, 0x56, 0x4d, 0x31, 0x04, 0x03, 0x00, 0x00, 0x29, 0x00, 0x1b, 0x05, 0x00,
+    0x01, 0x00, 0x05, 0x01, 0x1c, 0x05, 0x02, 0x04, 0x01, 0x04, 0x02, 0x15, 0x27,
+    0x16, 0x00, 0x04, 0x01, 0x04, 0x00, 0x04, 0x01, 0x01, 0x08, 0x0b, 0x09, 0x19,
+    0x01, 0x00, 0x01, 0x00, 0x1f, 0x20, 0x28, 0x01, 0x02, 0xea, 0xff, 0x00,
+};
+
+// Compiled by tools/led_vm.py from:
+//     fill(0, count, rgb(sin(time), 0, 0))
+static const uint8_t led_benchmark_vm_range[] = {
+    0x4c, 0x56, 0x4d, 0x31, 0x05, 0x00, 0x00, 0x00, 0x0c, 0x00, 0x01,
+    0x00, 0x1c, 0x1b, 0x19, 0x01, 0x00, 0x01, 0x00, 0x1f, 0x21, 0x00,
+};
+
+/// @brief The same sine the VM uses, so the native effects do the same work.
+static int32_t led_benchmark_sin(int32_t phase) {
+    const int32_t half = phase & 127;
+    const int32_t height = (half * (128 - half)) >> 5;
+    return CLAMP((phase & 128) ? 128 - height : 128 + height, 255, 0);
+}
+
+/// @brief Times a script against the native effect it stands in for.
+static void led_benchmark_vm(
+    const char* name,
+    const uint8_t* program,
+    size_t size,
+    LedFramebuffer_t* framebuffer,
+    LedArena_t* vmArena) {
+    ledArenaReset(vmArena);
+    LedVm_t vm;
+    LedVmStatus status = ledVmLoad(&vm, vmArena, program, size, 0);
+    if(status != LED_VM_OK) {
+        FURI_LOG_E(TAG, "%s script failed to load (%d)", name, status);
+        return;
+    }
+
+    uint32_t start = DWT->CYCCNT;
+    for(uint32_t j = 0; j < LED_BENCHMARK_ITERATIONS; j++) {
+        ledVmRun(&vm, framebuffer, j);
+    }
+    const uint32_t scriptCycles = (DWT->CYCCNT - start) / LED_BENCHMARK_ITERATIONS;
+
+    start = DWT->CYCCNT;
+    for(uint32_t j = 0; j < LED_BENCHMARK_ITERATIONS; j++) {
+        if(program == led_benchmark_vm_loop) {
+            for(uint16_t i = 0; i < framebuffer->count; i++) {
+                ledFramebufferSetPixel(framebuffer, i, led_benchmark_sin(j + i * 8) << 16);
+            }
+        } else {
+            ledFramebufferFill(framebuffer, led_benchmark_sin(j) << 16);
+        }
+    }
+    const uint32_t nativeCycles = (DWT->CYCCNT - start) / LED_BENCHMARK_ITERATIONS;
+
+    FURI_LOG_I(
+        TAG,
+        "%s script: %lu cycles/frame, native %lu cycles/frame (%lu.%02lux)",
+        name,
+        scriptCycles,
+        nativeCycles,
+        scriptCycles / MAX(nativeCycles, 1UL),
+        (scriptCycles * 100 / MAX(nativeCycles, 1UL)) % 100);
+}
+
+void ledRunEncodeBenchmark() {
+    size_t capacity = ws2812bTimerBufferLength(LED_BENCHMARK_LED_COUNT) * sizeof(uint16_t) +
+                      ledFramebufferArenaSize(LedPixelFormatRgb, LED_BENCHMARK_LED_COUNT) +
+                      LED_VM_ARENA_SIZE;
+    for(size_t i = 0; i < COUNT_OF(led_benchmark_cases); i++) {
+        capacity +=
+            ledFramebufferArenaSize(led_benchmark_cases[i].format, LED_BENCHMARK_LED_COUNT);
+    }
+
+    LedArena_t arena = {0};
+    if(ledArenaInit(&arena, capacity) != LED_ARENA_OK) {
+        FURI_LOG_E(TAG, "Not enough memory to run the encode benchmark");
+        return;
+    }
+    uint16_t* timerBuffer = ledArenaAlloc(
+        &arena, ws2812bTimerBufferLength(LED_BENCHMARK_LED_COUNT) * sizeof(uint16_t));
+
+    FURI_LOG_I(
+        TAG,
+        "Encode benchmark: %u LEDs, %u iterations",
+        LED_BENCHMARK_LED_COUNT,
+        LED_BENCHMARK_ITERATIONS);
+    for(size_t i = 0; i < COUNT_OF(led_benchmark_cases); i++) {
+        const LedBenchmarkCase_t* benchmark = &led_benchmark_cases[i];
+        LedFramebuffer_t framebuffer;
+        if(!ledFramebufferInit(
+               &framebuffer, &arena, benchmark->format, LED_BENCHMARK_LED_COUNT)) {
+            break;
+        }
+        led_benchmark_fill(&framebuffer);
+
+        uint32_t start = DWT->CYCCNT;
+        for(uint32_t j = 0; j < LED_BENCHMARK_ITERATIONS; j++) {
+            ws2812bEncode(&framebuffer, timerBuffer);
+        }
+        const uint32_t encodeCycles = (DWT->CYCCNT - start) / LED_BENCHMARK_ITERATIONS;
+
+        start = DWT->CYCCNT;
+        for(uint32_t j = 0; j < LED_BENCHMARK_ITERATIONS; j++) {
+            led_benchmark_animate(&framebuffer);
+        }
+        const uint32_t animateCycles = (DWT->CYCCNT - start) / LED_BENCHMARK_ITERATIONS;
+
+        FURI_LOG_I(
+            TAG,
+            "%s: %u pixel bytes, encode %lu cycles/frame (%lu/LED, %lu LEDs/ms), "
+            "animate %lu cycles/frame",
+            benchmark->name,
+            ledFramebufferArenaSize(benchmark->format, LED_BENCHMARK_LED_COUNT),
+            encodeCycles,
+            encodeCycles / LED_BENCHMARK_LED_COUNT,
+            (uint32_t)((uint64_t)LED_BENCHMARK_LED_COUNT * (SystemCoreClock / 1000) /
+                       encodeCycles),
+            animateCycles);
+    }
+
+    // Effect scripts, per LED and with a range op, against native C
+    LedFramebuffer_t framebuffer;
+    LedArena_t vmArena;
+    if(ledFramebufferInit(&framebuffer, &arena, LedPixelFormatRgb, LED_BENCHMARK_LED_COUNT) &&
+       ledArenaSplit(&arena, &vmArena, LED_VM_ARENA_SIZE)) {
+        led_benchmark_vm(
+            "Loop", led_benchmark_vm_loop, sizeof(led_benchmark_vm_loop), &framebuffer, &vmArena);
+        led_benchmark_vm(
+            "Range",
+            led_benchmark_vm_range,
+            sizeof(led_benchmark_vm_range),
+            &framebuffer,
+            &vmArena);
+    }
+
+    ledArenaFree(&arena);
+}
+
+#endif
@@ -0,0 +1,6 @@
+#pragma once
+
+/// @brief Logs how long it takes to encode a WS2812B frame from each pixel
+/// format, and to animate by rotating a palette compared to shifting RGB pixels.
+/// Only built when LIGHT_UP_BENCHMARK is defined.
+void ledRunEncodeBenchmark();
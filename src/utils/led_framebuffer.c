@@ -0,0 +1,144 @@
+#include <furi.h>
+
+#include "led_framebuffer.h"
+
+#define LED_FRAMEBUFFER_FNV_OFFSET 2166136261UL
+#define LED_FRAMEBUFFER_FNV_PRIME 16777619UL
+
+uint16_t ledFramebufferPaletteSize(LedPixelFormat format) {
+    switch(format) {
+    case LedPixelFormatIndexed4:
+        return 16;
+    case LedPixelFormatIndexed8:
+        return 256;
+    default:
+        return 0;
+    }
+}
+
+size_t ledFramebufferSize(LedPixelFormat format, uint16_t ledCount) {
+    switch(format) {
+    case LedPixelFormatIndexed4:
+        return ((size_t)ledCount + 1) / 2;
+    case LedPixelFormatIndexed8:
+        return ledCount;
+    default:
+        return (size_t)ledCount * LED_FRAMEBUFFER_BYTES_PER_LED;
+    }
+}
+
+size_t ledFramebufferArenaSize(LedPixelFormat format, uint16_t ledCount) {
+    return ledArenaAlignSize(ledFramebufferSize(format, ledCount)) +
+           ledArenaAlignSize(ledFramebufferPaletteSize(format) * sizeof(uint32_t));
+}
+
+bool ledFramebufferInit(
+    LedFramebuffer_t* framebuffer,
+    LedArena_t* arena,
+    LedPixelFormat format,
+    uint16_t ledCount) {
+    framebuffer->format = format;
+    framebuffer->count = 0;
+    framebuffer->paletteSize = ledFramebufferPaletteSize(format);
+    framebuffer->palette = NULL;
+    framebuffer->pixels = ledArenaAlloc(arena, ledFramebufferSize(format, ledCount));
+    if(framebuffer->pixels == NULL) {
+        return false;
+    }
+    if(framebuffer->paletteSize > 0) {
+        framebuffer->palette = ledArenaAlloc(arena, framebuffer->paletteSize * sizeof(uint32_t));
+        if(framebuffer->palette == NULL) {
+            return false;
+        }
+        memset(framebuffer->palette, 0, framebuffer->paletteSize * sizeof(uint32_t));
+    }
+    framebuffer->count = ledCount;
+    memset(framebuffer->pixels, 0, ledFramebufferSize(format, ledCount));
+    return true;
+}
+
+void ledFramebufferFill(LedFramebuffer_t* framebuffer, uint32_t rgb) {
+    if(framebuffer->format != LedPixelFormatRgb) {
+        memset(
+            framebuffer->pixels, 0, ledFramebufferSize(framebuffer->format, framebuffer->count));
+        ledFramebufferSetPaletteEntry(framebuffer, 0, rgb);
+        return;
+    }
+    for(uint16_t i = 0; i < framebuffer->count; i++) {
+        ledFramebufferSetPixel(framebuffer, i, rgb);
+    }
+}
+
+void ledFramebufferSetPixel(LedFramebuffer_t* framebuffer, uint16_t index, uint32_t rgb) {
+    furi_assert(framebuffer->format == LedPixelFormatRgb);
+    furi_assert(index < framebuffer->count);
+    uint8_t* pixel = &framebuffer->pixels[index * LED_FRAMEBUFFER_BYTES_PER_LED];
+    pixel[0] = (rgb >> 16) & 0xFF;
+    pixel[1] = (rgb >> 8) & 0xFF;
+    pixel[2] = rgb & 0xFF;
+}
+
+void ledFramebufferSetIndex(LedFramebuffer_t* framebuffer, uint16_t index, uint8_t entry) {
+    furi_assert(index < framebuffer->count);
+    furi_assert(entry < framebuffer->paletteSize);
+    if(framebuffer->format == LedPixelFormatIndexed8) {
+        framebuffer->pixels[index] = entry;
+    } else {
+        // Even LEDs are in the low nibble, odd LEDs in the high nibble
+        uint8_t* pixel = &framebuffer->pixels[index / 2];
+        const uint8_t shift = (index & 1) * 4;
+        *pixel = (*pixel & ~(0x0F << shift)) | ((entry & 0x0F) << shift);
+    }
+}
+
+void ledFramebufferSetPaletteEntry(LedFramebuffer_t* framebuffer, uint8_t entry, uint32_t rgb) {
+    furi_assert(entry < framebuffer->paletteSize);
+    framebuffer->palette[entry] = ledFramebufferSwapRedGreen(rgb & 0xFFFFFF);
+}
+
+void ledFramebufferRotatePalette(LedFramebuffer_t* framebuffer, uint16_t start, uint16_t length) {
+    furi_assert(start + length <= framebuffer->paletteSize);
+    if(length < 2) {
+        return;
+    }
+    uint32_t* entries = &framebuffer->palette[start];
+    const uint32_t first = entries[0];
+    memmove(entries, entries + 1, (length - 1) * sizeof(uint32_t));
+    entries[length - 1] = first;
+}
+
+uint32_t ledFramebufferGetPixel(const LedFramebuffer_t* framebuffer, uint16_t index) {
+    furi_assert(index < framebuffer->count);
+    switch(framebuffer->format) {
+    case LedPixelFormatIndexed4:
+        return ledFramebufferSwapRedGreen(
+            framebuffer->palette[(framebuffer->pixels[index / 2] >> ((index & 1) * 4)) & 0x0F]);
+    case LedPixelFormatIndexed8:
+        return ledFramebufferSwapRedGreen(framebuffer->palette[framebuffer->pixels[index]]);
+    default: {
+        const uint8_t* pixel = &framebuffer->pixels[index * LED_FRAMEBUFFER_BYTES_PER_LED];
+        return ((uint32_t)pixel[0] << 16) | ((uint32_t)pixel[1] << 8) | pixel[2];
+    }
+    }
+}
+
+static uint32_t led_framebuffer_hash_bytes(uint32_t hash, const uint8_t* bytes, size_t size) {
+    for(size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * LED_FRAMEBUFFER_FNV_PRIME;
+    }
+    return hash;
+}
+
+uint32_t ledFramebufferHash(const LedFramebuffer_t* framebuffer) {
+    uint32_t hash = led_framebuffer_hash_bytes(
+        LED_FRAMEBUFFER_FNV_OFFSET,
+        framebuffer->pixels,
+        ledFramebufferSize(framebuffer->format, framebuffer->count));
+    if(framebuffer->paletteSize > 0) {
+        hash = led_framebuffer_hash_bytes(
+            hash,
+            (const uint8_t*)framebuffer->palette,
+            framebuffer->paletteSize * sizeof(uint32_t));
+    }
+    return hash;
+}
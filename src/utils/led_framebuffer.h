@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "led_arena.h"
+
+/// @brief RGB pixels are stored as packed R, G, B bytes.
+#define LED_FRAMEBUFFER_BYTES_PER_LED 3
+
+/// @brief How the pixels in a framebuffer are stored.
+typedef enum {
+    LedPixelFormatRgb, // 3 bytes per LED
+    LedPixelFormatIndexed4, // 4 bit palette index per LED, 16 entry palette
+    LedPixelFormatIndexed8, // 8 bit palette index per LED, 256 entry palette
+} LedPixelFormat;
+
+/// @brief The colors that should currently be on the strip, in strip order.
+typedef struct {
+    LedPixelFormat format;
+    uint16_t count;
+    uint8_t* pixels;
+    // Only used by indexed formats. Entries are kept in the order the strip
+    // wants them, 0x00GGRRBB, so the encoder can use them as they are.
+    uint32_t* palette;
+    uint16_t paletteSize;
+} LedFramebuffer_t;
+
+/// @brief Gets the number of palette entries a pixel format uses.
+/// @param format The pixel format.
+/// @return The number of palette entries, 0 for RGB.
+uint16_t ledFramebufferPaletteSize(LedPixelFormat format);
+
+/// @brief Gets the number of bytes the pixels of a framebuffer need, not counting the palette.
+/// @param format The pixel format.
+/// @param ledCount The number of LEDs on the strip.
+/// @return The size in bytes of the pixel storage.
+size_t ledFramebufferSize(LedPixelFormat format, uint16_t ledCount);
+
+/// @brief Gets the number of bytes a framebuffer needs from an arena, palette included.
+/// @param format The pixel format.
+/// @param ledCount The number of LEDs on the strip.
+/// @return The size in bytes to reserve in the arena.
+size_t ledFramebufferArenaSize(LedPixelFormat format, uint16_t ledCount);
+
+/// @brief Carves the pixel storage for a framebuffer out of the given arena.
+/// @param framebuffer The framebuffer to initialize. All pixels start off.
+/// @param arena The arena to allocate the pixels from.
+/// @param format How the pixels are stored.
+/// @param ledCount The number of LEDs on the strip.
+/// @return Returns true on success, false if the arena did not have enough room.
+bool ledFramebufferInit(
+    LedFramebuffer_t* framebuffer,
+    LedArena_t* arena,
+    LedPixelFormat format,
+    uint16_t ledCount);
+
+/// @brief Sets every pixel in the framebuffer to a single color. Indexed
+/// framebuffers set every pixel to the first palette entry instead.
+/// @param framebuffer The framebuffer to update.
+/// @param rgb The color in the format of 0xRRGGBB.
+void ledFramebufferFill(LedFramebuffer_t* framebuffer, uint32_t rgb);
+
+/// @brief Sets a single pixel in an RGB framebuffer.
+/// @param framebuffer The framebuffer to update.
+/// @param index The index of the LED on the strip.
+/// @param rgb The color in the format of 0xRRGGBB.
+void ledFramebufferSetPixel(LedFramebuffer_t* framebuffer, uint16_t index, uint32_t rgb);
+
+/// @brief Sets the palette entry used by a single pixel in an indexed framebuffer.
+/// @param framebuffer The framebuffer to update.
+/// @param index The index of the LED on the strip.
+/// @param entry The palette entry to use.
+void ledFramebufferSetIndex(LedFramebuffer_t* framebuffer, uint16_t index, uint8_t entry);
+
+/// @brief Sets the color of a palette entry in an indexed framebuffer.
+/// @param framebuffer The framebuffer to update.
+/// @param entry The palette entry to set.
+/// @param rgb The color in the format of 0xRRGGBB.
+void ledFramebufferSetPaletteEntry(LedFramebuffer_t* framebuffer, uint8_t entry, uint32_t rgb);
+
+/// @brief Rotates a run of palette entries, which animates every pixel using
+/// them while only touching the palette.
+/// @param framebuffer The framebuffer to update.
+/// @param start The first palette entry to rotate.
+/// @param length The number of palette entries to rotate.
+void ledFramebufferRotatePalette(LedFramebuffer_t* framebuffer, uint16_t start, uint16_t length);
+
+/// @brief Gets a single pixel from the framebuffer, looking it up in the palette if needed.
+/// @param framebuffer The framebuffer to read from.
+/// @param index The index of the LED on the strip.
+/// @return The color in the format of 0xRRGGBB.
+uint32_t ledFramebufferGetPixel(const LedFramebuffer_t* framebuffer, uint16_t index);
+
+/// @brief Hashes the pixels in the framebuffer, so that unchanged frames can be skipped.
+/// @param framebuffer The framebuffer to hash.
+/// @return A 32 bit FNV-1a hash of the pixels, and palette if there is one.
+uint32_t ledFramebufferHash(const LedFramebuffer_t* framebuffer);
+
+/// @brief Converts a color between 0xRRGGBB and the strip's 0xGGRRBB order.
+/// Swapping the top two bytes works both ways.
+static inline uint32_t ledFramebufferSwapRedGreen(uint32_t color) {
+    return ((color & 0xFF0000) >> 8) | ((color & 0xFF00) << 8) | (color & 0xFF);
+}
@@ -0,0 +1,68 @@
+#include <furi.h>
+
+#include "led_governor.h"
+
+#define LED_GOVERNOR_MIN_INTERVAL_US (1000000UL / LED_GOVERNOR_MAX_FPS)
+#define LED_GOVERNOR_MAX_INTERVAL_US (1000000UL / LED_GOVERNOR_MIN_FPS)
+// Leave a quarter of the time spent rendering and encoding free for the rest
+// of the system, and at least as long again as a send, which masks interrupts
+#define LED_GOVERNOR_HEADROOM(cpuUs, transmitUs) ((cpuUs) + (cpuUs) / 4 + 2 * (transmitUs))
+// Frames in a row with spare time needed before the rate goes back up
+#define LED_GOVERNOR_RAISE_FRAMES 30
+
+static void led_governor_set_interval(LedGovernor_t* governor, uint32_t intervalUs) {
+    governor->frameIntervalUs =
+        CLAMP(intervalUs, LED_GOVERNOR_MAX_INTERVAL_US, LED_GOVERNOR_MIN_INTERVAL_US);
+    governor->fps = 1000000UL / governor->frameIntervalUs;
+}
+
+/// @brief Smooths a cost out, but never lets it hide a frame that overran.
+static void led_governor_smooth(uint32_t* costUs, uint32_t sampleUs, uint32_t intervalUs) {
+    if(*costUs == 0 || sampleUs > intervalUs) {
+        *costUs = sampleUs;
+    } else {
+        *costUs = *costUs - *costUs / 4 + sampleUs / 4;
+    }
+}
+
+void ledGovernorInit(LedGovernor_t* governor) {
+    governor->renderCostUs = 0;
+    governor->encodeCostUs = 0;
+    governor->transmitCostUs = 0;
+    governor->headroomFrames = 0;
+    led_governor_set_interval(governor, LED_GOVERNOR_MIN_INTERVAL_US);
+}
+
+bool ledGovernorRecord(LedGovernor_t* governor, const LedFrameTiming_t* timing, bool sent) {
+    const uint32_t previousFps = governor->fps;
+
+    led_governor_smooth(&governor->renderCostUs, timing->renderUs, governor->frameIntervalUs);
+    if(sent) {
+        led_governor_smooth(&governor->encodeCostUs, timing->encodeUs, governor->frameIntervalUs);
+        led_governor_smooth(
+            &governor->transmitCostUs, timing->transmitUs, governor->frameIntervalUs);
+    }
+
+    const uint32_t sustainableUs = LED_GOVERNOR_HEADROOM(
+        governor->renderCostUs + governor->encodeCostUs, governor->transmitCostUs);
+    if(sustainableUs > governor->frameIntervalUs) {
+        led_governor_set_interval(governor, sustainableUs);
+        governor->headroomFrames = 0;
+    } else if(sustainableUs < governor->frameIntervalUs - governor->frameIntervalUs / 4) {
+        if(++governor->headroomFrames >= LED_GOVERNOR_RAISE_FRAMES) {
+            // Step towards the sustainable rate instead of jumping straight to it
+            led_governor_set_interval(
+                governor,
+                MAX(sustainableUs, governor->frameIntervalUs - governor->frameIntervalUs / 8));
+            governor->headroomFrames = 0;
+        }
+    } else {
+        governor->headroomFrames = 0;
+    }
+
+    return governor->fps != previousFps;
+}
+
+uint32_t ledGovernorFrameIntervalMs(const LedGovernor_t* governor) {
+    return (governor->frameIntervalUs + 999) / 1000;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/// @brief The fastest the governor will let effects render.
+#define LED_GOVERNOR_MAX_FPS 60
+/// @brief The slowest the governor will let effects render.
+#define LED_GOVERNOR_MIN_FPS 5
+
+/// @brief How long the parts of a single frame took, in microseconds.
+typedef struct {
+    uint32_t renderUs;
+    uint32_t encodeUs;
+    uint32_t transmitUs;
+} LedFrameTiming_t;
+
+/// @brief Tracks how long frames take to render, encode and send, and picks
+/// a frame rate the strip can keep up with. Sending a frame masks interrupts,
+/// scheduler included, so unlike rendering and encoding it can't be shared
+/// with other threads. Frames are always at least twice as long as the send,
+/// so the rest of the system never gets less time than the strip takes, no
+/// matter how long the strip is.
+typedef struct {
+    // Smoothed cost of each part of a frame, in microseconds. Encoding and
+    // sending are only measured on frames that were actually sent.
+    uint32_t renderCostUs;
+    uint32_t encodeCostUs;
+    uint32_t transmitCostUs;
+    uint32_t frameIntervalUs;
+    uint16_t headroomFrames;
+    uint32_t fps;
+} LedGovernor_t;
+
+/// @brief Starts the governor off at the fastest rate it allows.
+/// @param governor The governor to initialize.
+void ledGovernorInit(LedGovernor_t* governor);
+
+/// @brief Records how long a frame took and adjusts the target rate. The rate
+/// drops straight away when frames overrun, and climbs back slowly once
+/// there has been headroom for a while.
+/// @param governor The governor to update.
+/// @param timing How long each part of the frame took.
+/// @param sent Whether the frame was sent. Only the render time of frames that
+/// were skipped is recorded, the last sent frames still stand in for the rest.
+/// @return Returns true if the target frame rate changed.
+bool ledGovernorRecord(LedGovernor_t* governor, const LedFrameTiming_t* timing, bool sent);
+
+/// @brief Gets how long to wait between the start of each frame.
+/// @param governor The governor to read from.
+/// @return The frame interval in milliseconds.
+uint32_t ledGovernorFrameIntervalMs(const LedGovernor_t* governor);
@@ -0,0 +1,53 @@
+#include <furi.h>
+
+#include "led_preview.h"
+
+#define LED_PREVIEW_INDEX_MASK 0x3
+#define LED_PREVIEW_FRESH 0x4
+
+void ledPreviewInit(LedPreview_t* preview) {
+    memset(preview->snapshots, 0, sizeof(preview->snapshots));
+    preview->shared = 0;
+    preview->readIndex = 1;
+    preview->writeIndex = 2;
+}
+
+static uint8_t led_preview_level(const LedFramebuffer_t* framebuffer, uint16_t index) {
+    const uint32_t rgb = ledFramebufferGetPixel(framebuffer, index);
+    return MAX(MAX((rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF), rgb & 0xFF);
+}
+
+void ledPreviewPublish(LedPreview_t* preview, const LedFramebuffer_t* framebuffer) {
+    LedPreviewSnapshot_t* snapshot = &preview->snapshots[preview->writeIndex];
+    if(framebuffer == NULL || framebuffer->count == 0) {
+        snapshot->ledCount = 0;
+        snapshot->cellCount = 0;
+    } else {
+        snapshot->ledCount = framebuffer->count;
+        snapshot->cellCount = MIN(framebuffer->count, LED_PREVIEW_MAX_CELLS);
+        for(uint16_t cell = 0; cell < snapshot->cellCount; cell++) {
+            // Keep the brightest LED so a single lit one still shows up
+            const uint16_t first = (uint32_t)cell * framebuffer->count / snapshot->cellCount;
+            const uint16_t last = (uint32_t)(cell + 1) * framebuffer->count / snapshot->cellCount;
+            uint8_t level = 0;
+            for(uint16_t i = first; i < last; i++) {
+                level = MAX(level, led_preview_level(framebuffer, i));
+            }
+            snapshot->levels[cell] = level;
+        }
+    }
+
+    // Publish the finished snapshot and take back whichever one it replaced
+    const uint32_t previous = __atomic_exchange_n(
+        &preview->shared, preview->writeIndex | LED_PREVIEW_FRESH, __ATOMIC_ACQ_REL);
+    preview->writeIndex = previous & LED_PREVIEW_INDEX_MASK;
+}
+
+const LedPreviewSnapshot_t* ledPreviewRead(LedPreview_t* preview) {
+    if(__atomic_load_n(&preview->shared, __ATOMIC_ACQUIRE) & LED_PREVIEW_FRESH) {
+        const uint32_t previous =
+            __atomic_exchange_n(&preview->shared, preview->readIndex, __ATOMIC_ACQ_REL);
+        preview->readIndex = previous & LED_PREVIEW_INDEX_MASK;
+    }
+    return &preview->snapshots[preview->readIndex];
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "led_framebuffer.h"
+
+/// @brief The most cells a preview shows, longer strips are scaled down to fit.
+#define LED_PREVIEW_MAX_CELLS 128
+
+/// @brief A scaled down copy of what the strip is showing.
+typedef struct {
+    // The number of LEDs on the strip, 0 when nothing is being sent to it.
+    uint16_t ledCount;
+    uint16_t cellCount;
+    // The brightest channel of the brightest LED each cell covers.
+    uint8_t levels[LED_PREVIEW_MAX_CELLS];
+} LedPreviewSnapshot_t;
+
+/// @brief Hands snapshots from the LED worker to the GUI without either side
+/// ever waiting on the other. There are three snapshots: one being written,
+/// one being drawn, and the newest finished one, which the two sides take
+/// turns swapping with a single atomic exchange.
+typedef struct {
+    LedPreviewSnapshot_t snapshots[3];
+    // The index of the newest finished snapshot, with LED_PREVIEW_FRESH set
+    // until the reader picks it up.
+    volatile uint32_t shared;
+    // Only touched by the writer.
+    uint8_t writeIndex;
+    // Only touched by the reader.
+    uint8_t readIndex;
+} LedPreview_t;
+
+/// @brief Starts the preview off showing nothing.
+/// @param preview The preview to initialize.
+void ledPreviewInit(LedPreview_t* preview);
+
+/// @brief Scales the framebuffer down into a new snapshot and publishes it.
+/// Only one thread may publish to a preview.
+/// @param preview The preview to publish to.
+/// @param framebuffer What the strip is showing, or NULL if it is off.
+void ledPreviewPublish(LedPreview_t* preview, const LedFramebuffer_t* framebuffer);
+
+/// @brief Gets the newest published snapshot. Only one thread may read from a preview.
+/// @param preview The preview to read from.
+/// @return The snapshot, which stays valid until the next call.
+const LedPreviewSnapshot_t* ledPreviewRead(LedPreview_t* preview);
@@ -0,0 +1,307 @@
+#include <furi.h>
+#include <furi_hal.h>
+#include <furi_hal_resources.h>
+#include <stm32wbxx_ll_tim.h>
+#include <stm32wbxx_ll_lptim.h>
+#include <stm32wbxx_ll_rcc.h>
+
+#include "led_pwm.h"
+#include "gpio_helper.h"
+#include "../main.h"
+
+// Fixed point gamma 2.2 curve, sampled at 33 points and interpolated in between.
+#define LED_PWM_GAMMA_POINTS 33
+static const uint16_t led_pwm_gamma_table[LED_PWM_GAMMA_POINTS] = {
+    0,     32,    147,   359,   676,   1104,  1648,  2314,  3104,  4022,  5072,
+    6255,  7574,  9033,  10632, 12375, 14263, 16298, 18482, 20816, 23303, 25943,
+    28739, 31692, 34802, 38072, 41503, 45097, 48853, 52774, 56860, 61114, 65535,
+};
+
+typedef enum {
+    LedPwmOutputTimer, // General purpose timer channel
+    LedPwmOutputAdvancedTimer, // Timer channel that also needs its main output enabled
+    LedPwmOutputLowPowerTimer,
+    LedPwmOutputSoftware, // No channel available, toggled by the shared interrupt
+} LedPwmOutput;
+
+typedef enum {
+    LedPwmPinUnknown, // Not set up by us, or handed back with ledPwmStop
+    LedPwmPinPushPull, // A plain output, on or driven by the shared interrupt
+    LedPwmPinOpenDrain, // Off and left floating
+    LedPwmPinTimer, // Connected to a timer channel
+} LedPwmPinMode;
+
+typedef struct {
+    const GpioPin* pin;
+    LedPwmOutput output;
+    FuriHalBus bus;
+    TIM_TypeDef* timer;
+    uint32_t channel;
+    GpioAltFn altFn;
+    bool active;
+    // Set while a hardware channel's timer is owned by something else.
+    bool fallback;
+    // How the pin is currently set up, so turning it on or off only re-inits it when needed.
+    LedPwmPinMode pinMode;
+    // Only used by software channels, read from the interrupt.
+    volatile uint8_t dutySteps;
+} LedPwmChannel_t;
+
+// One entry for each of the selectable pins in the GPIO test scene.
+static LedPwmChannel_t led_pwm_channels[] = {
+    {.pin = &gpio_ext_pa7,
+     .output = LedPwmOutputAdvancedTimer,
+     .bus = FuriHalBusTIM1,
+     .timer = TIM1,
+     .channel = LL_TIM_CHANNEL_CH1N,
+     .altFn = GpioAltFn1TIM1},
+    {.pin = &gpio_ext_pa6,
+     .output = LedPwmOutputAdvancedTimer,
+     .bus = FuriHalBusTIM16,
+     .timer = TIM16,
+     .channel = LL_TIM_CHANNEL_CH1,
+     .altFn = GpioAltFn14TIM16},
+    {.pin = &gpio_ext_pa4,
+     .output = LedPwmOutputLowPowerTimer,
+     .bus = FuriHalBusLPTIM2,
+     .altFn = GpioAltFn14LPTIM2},
+    {.pin = &gpio_ext_pb3,
+     .output = LedPwmOutputTimer,
+     .bus = FuriHalBusTIM2,
+     .timer = TIM2,
+     .channel = LL_TIM_CHANNEL_CH2,
+     .altFn = GpioAltFn1TIM2},
+    // LPTIM1 drives the system's idle timer, so PB2 has to be done in software
+    {.pin = &gpio_ext_pb2, .output = LedPwmOutputSoftware},
+    {.pin = &gpio_ext_pc3, .output = LedPwmOutputSoftware},
+};
+
+static bool led_pwm_software_running = false;
+static inline bool led_pwm_is_software(const LedPwmChannel_t* channel) {
+    return channel->output == LedPwmOutputSoftware || channel->fallback;
+}
+
+static uint8_t led_pwm_software_step = 0;
+// The clock LPTIM2 ran from before PA4 took it over, put back when it stops.
+static uint32_t led_pwm_lptim2_clock_source = LL_RCC_LPTIM2_CLKSOURCE_PCLK1;
+
+uint16_t ledPwmGamma(uint8_t brightness) {
+    // Position along the table in Q8
+    const uint32_t position = ((uint32_t)brightness * (LED_PWM_GAMMA_POINTS - 1) * 256) / 255;
+    const uint32_t index = position >> 8;
+    if(index >= LED_PWM_GAMMA_POINTS - 1) {
+        return led_pwm_gamma_table[LED_PWM_GAMMA_POINTS - 1];
+    }
+    const uint32_t fraction = position & 0xFF;
+    const uint32_t from = led_pwm_gamma_table[index];
+    const uint32_t to = led_pwm_gamma_table[index + 1];
+    return from + (((to - from) * fraction) >> 8);
+}
+
+static LedPwmChannel_t* led_pwm_find_channel(const GpioPin* gpioPin) {
+    for(size_t i = 0; i < COUNT_OF(led_pwm_channels); i++) {
+        if(led_pwm_channels[i].pin == gpioPin) {
+            return &led_pwm_channels[i];
+        }
+    }
+    return NULL;
+}
+
+/// @brief Turns a pin fully on or off, only setting it up again if it isn't
+/// already the right kind of output.
+static void led_pwm_set_level(LedPwmChannel_t* channel, const GpioPin* gpioPin, bool on) {
+    const LedPwmPinMode pinMode = on ? LedPwmPinPushPull : LedPwmPinOpenDrain;
+    if(channel != NULL && channel->pinMode == pinMode) {
+        furi_hal_gpio_write(gpioPin, on);
+        return;
+    }
+    setGpioPin(gpioPin, on);
+    if(channel != NULL) {
+        channel->pinMode = pinMode;
+    }
+}
+
+static void led_pwm_software_isr(void* context) {
+    UNUSED(context);
+    if(!LL_TIM_IsActiveFlag_UPDATE(TIM17)) {
+        return;
+    }
+    LL_TIM_ClearFlag_UPDATE(TIM17);
+
+    led_pwm_software_step = (led_pwm_software_step + 1) % LED_PWM_SOFTWARE_STEPS;
+    for(size_t i = 0; i < COUNT_OF(led_pwm_channels); i++) {
+        const LedPwmChannel_t* channel = &led_pwm_channels[i];
+        if(led_pwm_is_software(channel) && channel->active) {
+            const uint32_t pin = channel->pin->pin;
+            // Set or reset through BSRR so that other pins on the port are not touched
+            channel->pin->port->BSRR =
+                led_pwm_software_step < channel->dutySteps ? pin : (pin << GPIO_BSRR_BR0_Pos);
+        }
+    }
+}
+
+/// @brief Starts or stops the shared timer depending on whether any software channel needs it.
+/// @return Returns false if the timer is needed but something else already owns it.
+static bool led_pwm_software_update() {
+    bool needed = false;
+    for(size_t i = 0; i < COUNT_OF(led_pwm_channels); i++) {
+        needed |= led_pwm_is_software(&led_pwm_channels[i]) && led_pwm_channels[i].active;
+    }
+
+    if(needed && !led_pwm_software_running) {
+        if(furi_hal_bus_is_enabled(FuriHalBusTIM17)) {
+            // Whoever owns the timer owns its interrupt too, and setting either would crash
+            FURI_LOG_W(TAG, "Software PWM timer is busy");
+            return false;
+        }
+        FURI_LOG_D(TAG, "Starting software PWM timer");
+        furi_hal_bus_enable(FuriHalBusTIM17);
+        LL_TIM_SetPrescaler(TIM17, 0);
+        LL_TIM_SetAutoReload(
+            TIM17, SystemCoreClock / (LED_PWM_SOFTWARE_FREQUENCY_HZ * LED_PWM_SOFTWARE_STEPS) - 1);
+        furi_hal_interrupt_set_isr(FuriHalInterruptIdTim1TrgComTim17, led_pwm_software_isr, NULL);
+        LL_TIM_EnableIT_UPDATE(TIM17);
+        LL_TIM_EnableCounter(TIM17);
+        led_pwm_software_running = true;
+    } else if(!needed && led_pwm_software_running) {
+        FURI_LOG_D(TAG, "Stopping software PWM timer");
+        LL_TIM_DisableCounter(TIM17);
+        LL_TIM_DisableIT_UPDATE(TIM17);
+        furi_hal_interrupt_set_isr(FuriHalInterruptIdTim1TrgComTim17, NULL, NULL);
+        furi_hal_bus_disable(FuriHalBusTIM17);
+        led_pwm_software_running = false;
+    }
+    return true;
+}
+
+static void led_pwm_hardware_start(LedPwmChannel_t* channel) {
+    furi_hal_bus_enable(channel->bus);
+    if(channel->output == LedPwmOutputLowPowerTimer) {
+        led_pwm_lptim2_clock_source = LL_RCC_GetLPTIMClockSource(LL_RCC_LPTIM2_CLKSOURCE);
+        LL_RCC_SetLPTIMClockSource(LL_RCC_LPTIM2_CLKSOURCE_PCLK1);
+        LL_LPTIM_SetPrescaler(LPTIM2, LL_LPTIM_PRESCALER_DIV1);
+        LL_LPTIM_ConfigOutput(
+            LPTIM2, LL_LPTIM_OUTPUT_WAVEFORM_PWM, LL_LPTIM_OUTPUT_POLARITY_INVERSE);
+        LL_LPTIM_Enable(LPTIM2);
+        LL_LPTIM_SetAutoReload(LPTIM2, SystemCoreClock / LED_PWM_FREQUENCY_HZ - 1);
+        LL_LPTIM_StartCounter(LPTIM2, LL_LPTIM_OPERATING_MODE_CONTINUOUS);
+    } else {
+        LL_TIM_SetPrescaler(channel->timer, 0);
+        LL_TIM_SetAutoReload(channel->timer, SystemCoreClock / LED_PWM_FREQUENCY_HZ - 1);
+        LL_TIM_EnableARRPreload(channel->timer);
+        LL_TIM_OC_SetMode(channel->timer, channel->channel, LL_TIM_OCMODE_PWM1);
+        LL_TIM_OC_SetPolarity(channel->timer, channel->channel, LL_TIM_OCPOLARITY_HIGH);
+        LL_TIM_OC_EnablePreload(channel->timer, channel->channel);
+        LL_TIM_CC_EnableChannel(channel->timer, channel->channel);
+        if(channel->output == LedPwmOutputAdvancedTimer) {
+            LL_TIM_EnableAllOutputs(channel->timer);
+        }
+        LL_TIM_GenerateEvent_UPDATE(channel->timer);
+        LL_TIM_EnableCounter(channel->timer);
+    }
+    furi_hal_gpio_init_ex(
+        channel->pin, GpioModeAltFunctionPushPull, GpioPullNo, GpioSpeedVeryHigh, channel->altFn);
+    channel->pinMode = LedPwmPinTimer;
+}
+
+static void led_pwm_hardware_set_duty(LedPwmChannel_t* channel, uint16_t duty) {
+    const uint32_t period = SystemCoreClock / LED_PWM_FREQUENCY_HZ;
+    const uint32_t compare = ((uint64_t)period * duty) >> 16;
+    if(channel->output == LedPwmOutputLowPowerTimer) {
+        LL_LPTIM_SetCompare(LPTIM2, compare);
+    } else if(channel->channel == LL_TIM_CHANNEL_CH2) {
+        LL_TIM_OC_SetCompareCH2(channel->timer, compare);
+    } else {
+        LL_TIM_OC_SetCompareCH1(channel->timer, compare);
+    }
+}
+
+static void led_pwm_hardware_stop(LedPwmChannel_t* channel) {
+    if(channel->output == LedPwmOutputLowPowerTimer) {
+        LL_LPTIM_Disable(LPTIM2);
+        LL_RCC_SetLPTIMClockSource(led_pwm_lptim2_clock_source);
+    } else {
+        LL_TIM_DisableCounter(channel->timer);
+        LL_TIM_CC_DisableChannel(channel->timer, channel->channel);
+        if(channel->output == LedPwmOutputAdvancedTimer) {
+            LL_TIM_DisableAllOutputs(channel->timer);
+        }
+    }
+    furi_hal_bus_disable(channel->bus);
+}
+
+static void led_pwm_stop_channel(LedPwmChannel_t* channel) {
+    if(!channel->active) {
+        return;
+    }
+    channel->active = false;
+    if(led_pwm_is_software(channel)) {
+        channel->fallback = false;
+        led_pwm_software_update();
+    } else {
+        led_pwm_hardware_stop(channel);
+    }
+}
+
+bool ledPwmSet(const GpioPin* gpioPin, uint8_t brightness) {
+    LedPwmChannel_t* channel = led_pwm_find_channel(gpioPin);
+    if(channel == NULL || brightness == 0 || brightness == UINT8_MAX) {
+        // Fully on or off doesn't need a timer at all
+        if(channel != NULL) {
+            led_pwm_stop_channel(channel);
+        }
+        led_pwm_set_level(channel, gpioPin, brightness > 0);
+        return channel != NULL || brightness == 0 || brightness == UINT8_MAX;
+    }
+
+    const uint16_t duty = ledPwmGamma(brightness);
+    if(channel->output != LedPwmOutputSoftware && !channel->active &&
+       furi_hal_bus_is_enabled(channel->bus)) {
+        // Something else already owns the timer, so share the interrupt instead
+        FURI_LOG_W(TAG, "PWM timer for pin is busy, falling back to software");
+        channel->fallback = true;
+    }
+
+    if(led_pwm_is_software(channel)) {
+        channel->dutySteps = MAX(1U, ((uint32_t)duty * LED_PWM_SOFTWARE_STEPS) >> 16);
+        if(!channel->active) {
+            if(channel->pinMode != LedPwmPinPushPull) {
+                furi_hal_gpio_init(channel->pin, GpioModeOutputPushPull, GpioPullNo, GpioSpeedLow);
+                channel->pinMode = LedPwmPinPushPull;
+            }
+            channel->active = true;
+            if(!led_pwm_software_update()) {
+                // Nothing left to dim with, so at least light the pin up
+                channel->active = false;
+                channel->fallback = false;
+                led_pwm_set_level(channel, gpioPin, true);
+                return false;
+            }
+        }
+    } else {
+        if(!channel->active) {
+            led_pwm_hardware_start(channel);
+            channel->active = true;
+        }
+        led_pwm_hardware_set_duty(channel, duty);
+    }
+    return true;
+}
+
+void ledPwmStop(const GpioPin* gpioPin) {
+    LedPwmChannel_t* channel = led_pwm_find_channel(gpioPin);
+    if(channel != NULL) {
+        led_pwm_stop_channel(channel);
+        // Whatever uses the pin next may set it up differently
+        channel->pinMode = LedPwmPinUnknown;
+    }
+    setGpioPin(gpioPin, false);
+}
+
+void ledPwmStopAll() {
+    for(size_t i = 0; i < COUNT_OF(led_pwm_channels); i++) {
+        if(led_pwm_channels[i].active) {
+            ledPwmStop(led_pwm_channels[i].pin);
+        }
+    }
+}
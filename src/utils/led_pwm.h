@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <furi_hal_gpio.h>
+
+/// @brief The frequency of the PWM signal on pins with a hardware timer channel.
+#define LED_PWM_FREQUENCY_HZ 1000
+/// @brief The frequency of the PWM signal on pins driven by the shared timer interrupt.
+#define LED_PWM_SOFTWARE_FREQUENCY_HZ 200
+/// @brief The number of duty cycle steps for pins driven by the shared timer interrupt.
+#define LED_PWM_SOFTWARE_STEPS 64
+
+/// @brief Converts a perceived brightness to a duty cycle using a fixed point gamma curve.
+/// @param brightness The perceived brightness, from 0 to 255.
+/// @return The duty cycle in Q16, from 0 to 65535.
+uint16_t ledPwmGamma(uint8_t brightness);
+
+/// @brief Dims a pin. Pins with a timer output compare channel are driven entirely
+/// by the hardware, every other pin shares a single timer interrupt.
+/// @param gpioPin The pin to dim.
+/// @param brightness The perceived brightness, from 0 (off) to 255 (fully on).
+/// @return Returns false if no timer was free to dim the pin, in which case it is
+/// turned fully on instead.
+bool ledPwmSet(const GpioPin* gpioPin, uint8_t brightness);
+
+/// @brief Stops dimming a pin and turns it off.
+/// @param gpioPin The pin to turn off.
+void ledPwmStop(const GpioPin* gpioPin);
+
+/// @brief Stops dimming every pin and releases all of the timers.
+void ledPwmStopAll();
@@ -0,0 +1,230 @@
+#include <furi.h>
+
+#include "led_sequencer.h"
+#include "../main.h"
+
+// Progress and easing are worked out in Q16, then reduced to a Q8 weight
+#define LED_SEQUENCER_ONE_Q16 (1UL << 16)
+#define LED_SEQUENCER_ONE_Q8 (1U << 8)
+
+bool ledSequencerInit(
+    LedSequencer_t* sequencer,
+    LedArena_t* arena,
+    uint16_t capacity,
+    bool loop) {
+    sequencer->keyframes = ledArenaAlloc(arena, sizeof(LedKeyframe_t) * capacity);
+    sequencer->capacity = sequencer->keyframes != NULL ? capacity : 0;
+    sequencer->loop = loop;
+    ledSequencerClear(sequencer);
+    return sequencer->keyframes != NULL;
+}
+
+void ledSequencerClear(LedSequencer_t* sequencer) {
+    sequencer->count = 0;
+    sequencer->totalMs = 0;
+}
+
+bool ledSequencerAdd(LedSequencer_t* sequencer, const LedKeyframe_t* keyframe) {
+    if(sequencer->count >= sequencer->capacity) {
+        FURI_LOG_E(TAG, "Timeline is full (%u keyframes)", sequencer->capacity);
+        return false;
+    }
+    LedKeyframe_t* added = &sequencer->keyframes[sequencer->count++];
+    *added = *keyframe;
+    added->startMs = sequencer->totalMs;
+    sequencer->totalMs += keyframe->durationMs;
+    return true;
+}
+
+static uint32_t led_sequencer_ease(LedEasing easing, uint32_t progress) {
+    switch(easing) {
+    case LedEasingStep:
+        return 0;
+    case LedEasingLinear:
+        return progress;
+    case LedEasingEaseIn:
+        return ((uint64_t)progress * progress) >> 16;
+    case LedEasingEaseOut: {
+        uint32_t remaining = LED_SEQUENCER_ONE_Q16 - progress;
+        return LED_SEQUENCER_ONE_Q16 - (((uint64_t)remaining * remaining) >> 16);
+    }
+    case LedEasingEaseInOut:
+        // Smoothstep, 3p^2 - 2p^3
+        return ((uint64_t)progress * progress * (3 * LED_SEQUENCER_ONE_Q16 - 2 * progress)) >> 32;
+    default:
+        return progress;
+    }
+}
+
+int32_t ledSequencerSeek(const LedSequencer_t* sequencer, uint32_t timeMs, uint16_t* weight) {
+    *weight = 0;
+    if(sequencer->count == 0) {
+        return -1;
+    }
+    if(timeMs >= sequencer->totalMs) {
+        if(!sequencer->loop || sequencer->totalMs == 0) {
+            // Hold the last keyframe once the timeline is over
+            return sequencer->count - 1;
+        }
+        timeMs %= sequencer->totalMs;
+    }
+
+    // Find the last keyframe that starts at or before the given time
+    uint16_t low = 0;
+    uint16_t high = sequencer->count - 1;
+    while(low < high) {
+        uint16_t mid = (low + high + 1) / 2;
+        if(sequencer->keyframes[mid].startMs <= timeMs) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    const LedKeyframe_t* keyframe = &sequencer->keyframes[low];
+    if(keyframe->durationMs > 0) {
+        uint32_t progress =
+            ((uint64_t)(timeMs - keyframe->startMs) << 16) / keyframe->durationMs;
+        *weight = led_sequencer_ease(keyframe->easing, progress) >> 8;
+    }
+    return low;
+}
+
+/// @brief Gets the keyframe we are moving towards, which is the keyframe itself when there is none.
+static const LedKeyframe_t* led_sequencer_next(const LedSequencer_t* sequencer, int32_t index) {
+    if(index + 1 < sequencer->count) {
+        return &sequencer->keyframes[index + 1];
+    }
+    return sequencer->loop ? &sequencer->keyframes[0] : &sequencer->keyframes[index];
+}
+
+uint32_t ledSequencerNextChangeMs(const LedSequencer_t* sequencer, uint32_t timeMs) {
+    if(sequencer->count == 0 || sequencer->totalMs == 0 ||
+       (!sequencer->loop && timeMs >= sequencer->totalMs)) {
+        return UINT32_MAX;
+    }
+    timeMs %= sequencer->totalMs;
+
+    uint16_t weight;
+    int32_t index = ledSequencerSeek(sequencer, timeMs, &weight);
+    const LedKeyframe_t* keyframe = &sequencer->keyframes[index];
+    const LedKeyframe_t* next = led_sequencer_next(sequencer, index);
+    if(keyframe->easing != LedEasingStep && next != keyframe) {
+        return 0;
+    }
+    return keyframe->startMs + keyframe->durationMs - timeMs;
+}
+
+static inline uint8_t led_sequencer_lerp(uint8_t from, uint8_t to, uint16_t weight) {
+    return from + ((((int32_t)to - from) * weight) >> 8);
+}
+
+static uint32_t led_sequencer_lerp_rgb(uint32_t from, uint32_t to, uint16_t weight) {
+    return ((uint32_t)led_sequencer_lerp(from >> 16, to >> 16, weight) << 16) |
+           ((uint32_t)led_sequencer_lerp(from >> 8, to >> 8, weight) << 8) |
+           led_sequencer_lerp(from, to, weight);
+}
+
+static void led_sequencer_draw(const LedKeyframe_t* keyframe, LedFramebuffer_t* framebuffer) {
+    if(keyframe->type == LedKeyframeColor) {
+        ledFramebufferFill(framebuffer, keyframe->rgb);
+    } else if(keyframe->type == LedKeyframeFrame && framebuffer->format == LedPixelFormatRgb) {
+        memcpy(
+            framebuffer->pixels,
+            keyframe->pixels,
+            ledFramebufferSize(LedPixelFormatRgb, framebuffer->count));
+    } else if(keyframe->type == LedKeyframePalette && framebuffer->paletteSize > 0) {
+        for(uint16_t i = 0; i < framebuffer->paletteSize; i++) {
+            ledFramebufferSetPaletteEntry(framebuffer, i, keyframe->palette[i]);
+        }
+    }
+}
+
+/// @brief Checks whether two keyframes can be blended into the given framebuffer.
+static bool led_sequencer_can_blend(
+    const LedKeyframe_t* from,
+    const LedKeyframe_t* to,
+    const LedFramebuffer_t* framebuffer) {
+    if(from->type == LedKeyframeParams || to->type == LedKeyframeParams) {
+        return false;
+    }
+    if(framebuffer->format == LedPixelFormatRgb) {
+        return from->type != LedKeyframePalette && to->type != LedKeyframePalette;
+    }
+    // Indexed framebuffers are blended by blending their palettes
+    return from->type == LedKeyframePalette && to->type == LedKeyframePalette;
+}
+
+void ledSequencerRender(
+    const LedSequencer_t* sequencer,
+    uint32_t timeMs,
+    LedFramebuffer_t* framebuffer) {
+    uint16_t weight;
+    int32_t index = ledSequencerSeek(sequencer, timeMs, &weight);
+    if(index < 0) {
+        return;
+    }
+    const LedKeyframe_t* from = &sequencer->keyframes[index];
+    const LedKeyframe_t* to = led_sequencer_next(sequencer, index);
+
+    // Keyframes that can't be blended together are simply held
+    if(weight == 0 || !led_sequencer_can_blend(from, to, framebuffer)) {
+        led_sequencer_draw(from, framebuffer);
+        return;
+    }
+    if(weight >= LED_SEQUENCER_ONE_Q8) {
+        led_sequencer_draw(to, framebuffer);
+        return;
+    }
+    if(from->type == LedKeyframePalette) {
+        // Only costs as much as the palette, no matter how many LEDs there are
+        for(uint16_t i = 0; i < framebuffer->paletteSize; i++) {
+            ledFramebufferSetPaletteEntry(
+                framebuffer, i, led_sequencer_lerp_rgb(from->palette[i], to->palette[i], weight));
+        }
+        return;
+    }
+    if(from->type == LedKeyframeColor && to->type == LedKeyframeColor) {
+        ledFramebufferFill(framebuffer, led_sequencer_lerp_rgb(from->rgb, to->rgb, weight));
+        return;
+    }
+
+    // At least one side is a full frame, so blend every channel of every LED
+    uint8_t fromColor[LED_FRAMEBUFFER_BYTES_PER_LED] = {
+        from->rgb >> 16, from->rgb >> 8, from->rgb};
+    uint8_t toColor[LED_FRAMEBUFFER_BYTES_PER_LED] = {to->rgb >> 16, to->rgb >> 8, to->rgb};
+    const size_t fromStride = from->type == LedKeyframeFrame ? LED_FRAMEBUFFER_BYTES_PER_LED : 0;
+    const size_t toStride = to->type == LedKeyframeFrame ? LED_FRAMEBUFFER_BYTES_PER_LED : 0;
+    const uint8_t* fromPixel = from->type == LedKeyframeFrame ? from->pixels : fromColor;
+    const uint8_t* toPixel = to->type == LedKeyframeFrame ? to->pixels : toColor;
+    uint8_t* pixel = framebuffer->pixels;
+    for(uint16_t i = 0; i < framebuffer->count; i++) {
+        for(uint8_t c = 0; c < LED_FRAMEBUFFER_BYTES_PER_LED; c++) {
+            pixel[c] = led_sequencer_lerp(fromPixel[c], toPixel[c], weight);
+        }
+        pixel += LED_FRAMEBUFFER_BYTES_PER_LED;
+        fromPixel += fromStride;
+        toPixel += toStride;
+    }
+}
+
+bool ledSequencerGetParams(
+    const LedSequencer_t* sequencer,
+    uint32_t timeMs,
+    uint16_t params[LED_SEQUENCER_PARAM_COUNT]) {
+    uint16_t weight;
+    int32_t index = ledSequencerSeek(sequencer, timeMs, &weight);
+    if(index < 0 || sequencer->keyframes[index].type != LedKeyframeParams) {
+        return false;
+    }
+    const LedKeyframe_t* from = &sequencer->keyframes[index];
+    const LedKeyframe_t* to = led_sequencer_next(sequencer, index);
+    if(to->type != LedKeyframeParams) {
+        weight = 0;
+    }
+    for(uint8_t i = 0; i < LED_SEQUENCER_PARAM_COUNT; i++) {
+        params[i] = from->params[i] +
+                    ((((int32_t)to->params[i] - from->params[i]) * (int32_t)weight) >> 8);
+    }
+    return true;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "led_arena.h"
+#include "led_framebuffer.h"
+
+/// @brief The number of effect parameters a keyframe can hold.
+#define LED_SEQUENCER_PARAM_COUNT 4
+
+/// @brief Curves used to move from one keyframe to the next.
+typedef enum {
+    LedEasingStep, // Hold the keyframe, then jump to the next one
+    LedEasingLinear,
+    LedEasingEaseIn,
+    LedEasingEaseOut,
+    LedEasingEaseInOut,
+} LedEasing;
+
+/// @brief What a keyframe holds.
+typedef enum {
+    LedKeyframeColor, // A single color for the whole strip
+    LedKeyframeFrame, // A full frame of pixels, for RGB framebuffers
+    LedKeyframePalette, // A full palette, for indexed framebuffers
+    LedKeyframeParams, // Parameters for an effect, does not draw anything itself
+} LedKeyframeType;
+
+/// @brief A single point on the timeline. The duration and easing describe
+/// how long it takes, and how, to get from this keyframe to the next one.
+typedef struct {
+    LedKeyframeType type;
+    LedEasing easing;
+    uint32_t durationMs;
+    union {
+        uint32_t rgb;
+        // Packed RGB for every LED, not owned by the sequencer.
+        const uint8_t* pixels;
+        // 0xRRGGBB for every palette entry, not owned by the sequencer.
+        const uint32_t* palette;
+        uint16_t params[LED_SEQUENCER_PARAM_COUNT];
+    };
+    // Filled in by the sequencer when the keyframe is added.
+    uint32_t startMs;
+} LedKeyframe_t;
+
+/// @brief A timeline of keyframes. Frames in between keyframes are only
+/// computed when asked for, so memory only grows with the keyframe count.
+typedef struct {
+    LedKeyframe_t* keyframes;
+    uint16_t count;
+    uint16_t capacity;
+    uint32_t totalMs;
+    bool loop;
+} LedSequencer_t;
+
+/// @brief Carves the keyframe storage for a sequencer out of the given arena.
+/// @param sequencer The sequencer to initialize.
+/// @param arena The arena to allocate the keyframes from.
+/// @param capacity The maximum number of keyframes on the timeline.
+/// @param loop Whether the timeline starts over once it reaches the end.
+/// @return Returns true on success, false if the arena did not have enough room.
+bool ledSequencerInit(
+    LedSequencer_t* sequencer,
+    LedArena_t* arena,
+    uint16_t capacity,
+    bool loop);
+
+/// @brief Removes every keyframe from the timeline.
+/// @param sequencer The sequencer to clear.
+void ledSequencerClear(LedSequencer_t* sequencer);
+
+/// @brief Appends a keyframe to the end of the timeline.
+/// @param sequencer The sequencer to add to.
+/// @param keyframe The keyframe to copy onto the timeline.
+/// @return Returns true on success, false if the timeline is full.
+bool ledSequencerAdd(LedSequencer_t* sequencer, const LedKeyframe_t* keyframe);
+
+/// @brief Finds the keyframe that is playing at the given time in O(log n).
+/// @param sequencer The sequencer to search.
+/// @param timeMs The time since the start of the timeline.
+/// @param weight Set to how far, from 0 to 256, we are towards the next keyframe.
+/// @return The index of the keyframe, or -1 if the timeline is empty.
+int32_t ledSequencerSeek(const LedSequencer_t* sequencer, uint32_t timeMs, uint16_t* weight);
+
+/// @brief Works out how long the rendered frame will stay the same, so that
+/// a static timeline does not need to be rendered again until its next cue.
+/// @param sequencer The sequencer to check.
+/// @param timeMs The time since the start of the timeline.
+/// @return The time in ms until the next change, 0 if it is changing right now,
+/// or UINT32_MAX if it will never change again.
+uint32_t ledSequencerNextChangeMs(const LedSequencer_t* sequencer, uint32_t timeMs);
+
+/// @brief Renders the frame for the given time into the framebuffer.
+/// @param sequencer The sequencer to render.
+/// @param timeMs The time since the start of the timeline.
+/// @param framebuffer The framebuffer to draw into.
+void ledSequencerRender(
+    const LedSequencer_t* sequencer,
+    uint32_t timeMs,
+    LedFramebuffer_t* framebuffer);
+
+/// @brief Gets the effect parameters for the given time.
+/// @param sequencer The sequencer to read from.
+/// @param timeMs The time since the start of the timeline.
+/// @param params Set to the interpolated parameters.
+/// @return Returns true if a parameter keyframe is playing at the given time.
+bool ledSequencerGetParams(
+    const LedSequencer_t* sequencer,
+    uint32_t timeMs,
+    uint16_t params[LED_SEQUENCER_PARAM_COUNT]);
@@ -0,0 +1,73 @@
+#include <furi.h>
+
+#include "led_sprite.h"
+
+const LedSprite_t* ledSpriteFind(const char* name) {
+    for(size_t i = 0; i < ledSpriteCount; i++) {
+        if(strcmp(ledSprites[i]->name, name) == 0) {
+            return ledSprites[i];
+        }
+    }
+    return NULL;
+}
+
+bool ledMatrixInit(
+    LedMatrix_t* matrix,
+    LedFramebuffer_t* framebuffer,
+    uint8_t width,
+    uint8_t height,
+    LedMatrixLayout layout) {
+    if(framebuffer->format != LedPixelFormatRgb || (uint32_t)width * height > framebuffer->count) {
+        return false;
+    }
+    matrix->framebuffer = framebuffer;
+    matrix->width = width;
+    matrix->height = height;
+    matrix->layout = layout;
+    return true;
+}
+
+static bool led_matrix_row_reversed(const LedMatrix_t* matrix, uint8_t y) {
+    return matrix->layout == LedMatrixLayoutSerpentine && (y & 1);
+}
+
+uint16_t ledMatrixIndex(const LedMatrix_t* matrix, uint8_t x, uint8_t y) {
+    furi_assert(x < matrix->width && y < matrix->height);
+    const uint16_t rowStart = y * matrix->width;
+    return led_matrix_row_reversed(matrix, y) ? rowStart + matrix->width - 1 - x : rowStart + x;
+}
+
+void ledSpriteBlit(const LedMatrix_t* matrix, const LedSprite_t* sprite, int16_t x, int16_t y) {
+    // Only visit the rows that land on the matrix
+    const int16_t firstRow = MAX(0, -y);
+    const int16_t lastRow = MIN((int16_t)sprite->height, (int16_t)matrix->height - y);
+    for(int16_t row = firstRow; row < lastRow; row++) {
+        const uint8_t matrixY = y + row;
+        const bool reversed = led_matrix_row_reversed(matrix, matrixY);
+        uint8_t* rowPixels =
+            &matrix->framebuffer->pixels[matrixY * matrix->width * LED_FRAMEBUFFER_BYTES_PER_LED];
+
+        for(uint16_t s = sprite->rowSpans[row]; s < sprite->rowSpans[row + 1]; s++) {
+            const LedSpriteSpan_t* span = &sprite->spans[s];
+            // Clip the span to the matrix's columns
+            const int16_t spanStart = x + span->x;
+            const int16_t spanEnd = spanStart + span->length;
+            const int16_t start = MAX(spanStart, 0);
+            const int16_t end = MIN(spanEnd, (int16_t)matrix->width);
+            if(start >= end) {
+                continue;
+            }
+
+            // Rows wired right to left use the reversed copy of the span, whose
+            // right hand edge lands first, so both directions are a straight copy
+            const uint16_t column = reversed ? matrix->width - end : start;
+            const uint16_t first = reversed ? span->pixel + (spanEnd - end) :
+                                              span->pixel + (start - spanStart);
+            const uint8_t* source = reversed ? sprite->reversedPixels : sprite->pixels;
+            memcpy(
+                &rowPixels[column * LED_FRAMEBUFFER_BYTES_PER_LED],
+                &source[first * LED_FRAMEBUFFER_BYTES_PER_LED],
+                (end - start) * LED_FRAMEBUFFER_BYTES_PER_LED);
+        }
+    }
+}
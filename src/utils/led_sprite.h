@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "led_framebuffer.h"
+
+/// @brief A run of opaque pixels within a single row of a sprite.
+typedef struct {
+    // Column of the first pixel in the run.
+    uint8_t x;
+    uint8_t length;
+    // Index of the run's first pixel in the sprite's pixel data.
+    uint16_t pixel;
+} LedSpriteSpan_t;
+
+/// @brief An image converted from sprites/ at build time by tools/led_sprites.py.
+/// Only opaque pixels are stored, already packed as R, G, B bytes like an RGB
+/// framebuffer and in both directions, so drawing a span is a straight copy
+/// whichever way the row is wired.
+typedef struct {
+    const char* name;
+    uint8_t width;
+    uint8_t height;
+    // Packed RGB for each opaque pixel, row by row, left to right.
+    const uint8_t* pixels;
+    // The same pixels with each span running right to left, at the same offsets.
+    const uint8_t* reversedPixels;
+    const LedSpriteSpan_t* spans;
+    // The first span of each row, with one extra entry marking the end of the last row.
+    const uint16_t* rowSpans;
+} LedSprite_t;
+
+/// @brief Every sprite built from sprites/, in file name order. Generated at build time.
+extern const LedSprite_t* const ledSprites[];
+/// @brief The number of sprites in ledSprites.
+extern const size_t ledSpriteCount;
+
+/// @brief How the LEDs of a matrix are wired.
+typedef enum {
+    LedMatrixLayoutProgressive, // Every row runs left to right
+    LedMatrixLayoutSerpentine, // Rows alternate direction, the first runs left to right
+} LedMatrixLayout;
+
+/// @brief Maps a grid of pixels onto the LEDs of an RGB framebuffer.
+typedef struct {
+    LedFramebuffer_t* framebuffer;
+    uint8_t width;
+    uint8_t height;
+    LedMatrixLayout layout;
+} LedMatrix_t;
+
+/// @brief Finds a sprite by the name of the image it was built from.
+/// @param name The image's file name, without the .png extension.
+/// @return The sprite, or NULL if there is no sprite with that name.
+const LedSprite_t* ledSpriteFind(const char* name);
+
+/// @brief Sets up a matrix on top of an RGB framebuffer.
+/// @param matrix The matrix to initialize.
+/// @param framebuffer The framebuffer holding the matrix's LEDs, at least width * height long.
+/// @param width The number of LEDs in each row.
+/// @param height The number of rows.
+/// @param layout How the rows are wired.
+/// @return Returns true on success, false if the framebuffer is too small or not RGB.
+bool ledMatrixInit(
+    LedMatrix_t* matrix,
+    LedFramebuffer_t* framebuffer,
+    uint8_t width,
+    uint8_t height,
+    LedMatrixLayout layout);
+
+/// @brief Gets the index on the strip of the LED at a point on the matrix.
+/// @param matrix The matrix to look up.
+/// @param x The column, from the left.
+/// @param y The row, from the top.
+/// @return The index of the LED in the framebuffer.
+uint16_t ledMatrixIndex(const LedMatrix_t* matrix, uint8_t x, uint8_t y);
+
+/// @brief Draws a sprite onto the matrix. Transparent pixels are left as they
+/// were, and anything falling outside the matrix is clipped, so moving the
+/// position a little each frame scrolls the sprite across or off the matrix.
+/// @param matrix The matrix to draw onto.
+/// @param sprite The sprite to draw.
+/// @param x The column to draw the sprite's left edge at, may be negative.
+/// @param y The row to draw the sprite's top edge at, may be negative.
+void ledSpriteBlit(const LedMatrix_t* matrix, const LedSprite_t* sprite, int16_t x, int16_t y);
@@ -0,0 +1,598 @@
+#include <furi.h>
+#include <storage/storage.h>
+
+#include "led_vm.h"
+#include "../main.h"
+
+// Marks an offset in the verifier's depth table that no instruction has reached yet
+#define LED_VM_DEPTH_UNKNOWN 0xFF
+// Set on depth table entries where an instruction starts
+#define LED_VM_DEPTH_START 0x80
+#define LED_VM_DEPTH_MASK 0x3F
+
+/// @brief What an instruction takes and leaves on the stack, and how many
+/// immediate bytes follow it.
+typedef struct {
+    uint8_t pops;
+    uint8_t pushes;
+    uint8_t immediate;
+} LedVmOpInfo_t;
+
+static const LedVmOpInfo_t led_vm_op_info[LedVmOpSize] = {
+    [LedVmOpEnd] = {0, 0, 0},
+    [LedVmOpPush8] = {0, 1, 1},
+    [LedVmOpPush16] = {0, 1, 2},
+    [LedVmOpPush32] = {0, 1, 4},
+    [LedVmOpLoad] = {0, 1, 1},
+    [LedVmOpStore] = {1, 0, 1},
+    [LedVmOpDup] = {1, 2, 0},
+    [LedVmOpDrop] = {1, 0, 0},
+    [LedVmOpSwap] = {2, 2, 0},
+    [LedVmOpAdd] = {2, 1, 0},
+    [LedVmOpSub] = {2, 1, 0},
+    [LedVmOpMul] = {2, 1, 0},
+    [LedVmOpDiv] = {2, 1, 0},
+    [LedVmOpMod] = {2, 1, 0},
+    [LedVmOpAnd] = {2, 1, 0},
+    [LedVmOpOr] = {2, 1, 0},
+    [LedVmOpXor] = {2, 1, 0},
+    [LedVmOpShl] = {2, 1, 0},
+    [LedVmOpShr] = {2, 1, 0},
+    [LedVmOpMin] = {2, 1, 0},
+    [LedVmOpMax] = {2, 1, 0},
+    [LedVmOpLt] = {2, 1, 0},
+    [LedVmOpEq] = {2, 1, 0},
+    [LedVmOpNeg] = {1, 1, 0},
+    [LedVmOpNot] = {1, 1, 0},
+    [LedVmOpSin] = {1, 1, 0},
+    [LedVmOpNoise] = {1, 1, 0},
+    [LedVmOpTime] = {0, 1, 0},
+    [LedVmOpLedCount] = {0, 1, 0},
+    [LedVmOpColor] = {0, 1, 0},
+    [LedVmOpPal] = {1, 1, 0},
+    [LedVmOpRgb] = {3, 1, 0},
+    [LedVmOpSet] = {2, 0, 0},
+    [LedVmOpFill] = {3, 0, 0},
+    [LedVmOpGradient] = {4, 0, 0},
+    [LedVmOpPalRange] = {4, 0, 0},
+    [LedVmOpNoiseRange] = {4, 0, 0},
+    [LedVmOpFade] = {3, 0, 0},
+    [LedVmOpJump] = {0, 0, 2},
+    [LedVmOpJumpIfZero] = {1, 0, 2},
+    [LedVmOpLoop] = {0, 0, 4},
+};
+
+static inline int16_t led_vm_read_i16(const uint8_t* bytes) {
+    return (int16_t)(bytes[0] | (bytes[1] << 8));
+}
+
+static inline int32_t led_vm_read_i32(const uint8_t* bytes) {
+    return (int32_t)(
+        bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | ((uint32_t)bytes[3] << 24));
+}
+
+static inline bool led_vm_is_start(uint8_t depth) {
+    return depth != LED_VM_DEPTH_UNKNOWN && (depth & LED_VM_DEPTH_START);
+}
+
+/// @brief Records the stack depth an instruction must be reached with,
+/// making sure it matches any path that already reached it.
+static bool led_vm_merge_depth(uint8_t* depths, uint16_t offset, uint8_t depth) {
+    if(depths[offset] == LED_VM_DEPTH_UNKNOWN) {
+        depths[offset] = depth;
+        return true;
+    }
+    return (depths[offset] & LED_VM_DEPTH_MASK) == depth;
+}
+
+/// @brief Walks the code once in order, working out the stack depth at every
+/// instruction. Code must only be reachable by falling through or by a jump
+/// seen before it, which is all the compiler emits.
+static LedVmStatus led_vm_verify(const LedVm_t* vm, uint8_t* depths) {
+    memset(depths, LED_VM_DEPTH_UNKNOWN, vm->codeSize);
+    uint16_t pc = 0;
+    uint8_t depth = 0;
+    bool reachable = true;
+    while(pc < vm->codeSize) {
+        const uint8_t op = vm->code[pc];
+        if(op >= LedVmOpSize) {
+            return LED_VM_BAD_OPCODE;
+        }
+        if(reachable) {
+            if(!led_vm_merge_depth(depths, pc, depth)) {
+                return LED_VM_BAD_STACK;
+            }
+        } else if(depths[pc] == LED_VM_DEPTH_UNKNOWN) {
+            // Nothing jumps here, so there is no telling what the stack holds
+            return LED_VM_BAD_JUMP;
+        }
+        depth = depths[pc] & LED_VM_DEPTH_MASK;
+        depths[pc] |= LED_VM_DEPTH_START;
+        reachable = true;
+
+        const LedVmOpInfo_t* info = &led_vm_op_info[op];
+        const uint16_t next = pc + 1 + info->immediate;
+        if(next > vm->codeSize) {
+            return LED_VM_BAD_OPCODE;
+        }
+        if(depth < info->pops || depth - info->pops + info->pushes > vm->stackSize) {
+            return LED_VM_BAD_STACK;
+        }
+        depth = depth - info->pops + info->pushes;
+
+        switch(op) {
+        case LedVmOpLoad:
+        case LedVmOpStore:
+            if(vm->code[pc + 1] >= vm->varCount) {
+                return LED_VM_BAD_VARIABLE;
+            }
+            break;
+        case LedVmOpLoop:
+            if(vm->code[pc + 1] >= vm->varCount || vm->code[pc + 2] >= vm->varCount) {
+                return LED_VM_BAD_VARIABLE;
+            }
+            break;
+        case LedVmOpPal:
+        case LedVmOpPalRange:
+        case LedVmOpNoiseRange:
+            if(vm->paletteSize == 0) {
+                return LED_VM_NO_PALETTE;
+            }
+            break;
+        default:
+            break;
+        }
+
+        switch(op) {
+        case LedVmOpJump:
+        case LedVmOpJumpIfZero:
+        case LedVmOpLoop: {
+            // The offset is always the last immediate
+            const int32_t target = next + led_vm_read_i16(&vm->code[next - 2]);
+            if(target < 0 || target >= vm->codeSize) {
+                return LED_VM_BAD_JUMP;
+            }
+            // Backwards jumps must land on an instruction already walked,
+            // forwards ones are checked once the walk gets there
+            if(target <= pc && !led_vm_is_start(depths[target])) {
+                return LED_VM_BAD_JUMP;
+            }
+            if(!led_vm_merge_depth(depths, target, depth)) {
+                return LED_VM_BAD_STACK;
+            }
+            reachable = op != LedVmOpJump;
+            break;
+        }
+        case LedVmOpEnd:
+            reachable = false;
+            break;
+        default:
+            break;
+        }
+        pc = next;
+    }
+    if(reachable) {
+        // The last instruction would run off the end of the code
+        return LED_VM_BAD_JUMP;
+    }
+    // Every jump has to land on the start of an instruction
+    for(uint16_t i = 0; i < vm->codeSize; i++) {
+        if(depths[i] != LED_VM_DEPTH_UNKNOWN && !led_vm_is_start(depths[i])) {
+            return LED_VM_BAD_JUMP;
+        }
+    }
+    return LED_VM_OK;
+}
+
+LedVmStatus ledVmLoad(
+    LedVm_t* vm,
+    LedArena_t* arena,
+    const uint8_t* data,
+    size_t size,
+    uint32_t color) {
+    if(size > LED_VM_MAX_FILE_SIZE) {
+        return LED_VM_TOO_LARGE;
+    }
+    if(size < LED_VM_HEADER_SIZE || memcmp(data, LED_VM_MAGIC, 4) != 0) {
+        return LED_VM_BAD_HEADER;
+    }
+    vm->stackSize = data[4];
+    vm->varCount = data[5];
+    vm->paletteSize = data[6];
+    vm->codeSize = data[8] | (data[9] << 8);
+    if(vm->stackSize == 0 || vm->stackSize > LED_VM_MAX_STACK ||
+       vm->varCount > LED_VM_MAX_VARS || vm->paletteSize > LED_VM_MAX_PALETTE || data[7] != 0 ||
+       vm->codeSize == 0 ||
+       size != (size_t)LED_VM_HEADER_SIZE + vm->paletteSize * LED_FRAMEBUFFER_BYTES_PER_LED +
+                   vm->codeSize) {
+        return LED_VM_BAD_HEADER;
+    }
+    vm->palette = &data[LED_VM_HEADER_SIZE];
+    vm->code = &data[LED_VM_HEADER_SIZE + vm->paletteSize * LED_FRAMEBUFFER_BYTES_PER_LED];
+    vm->color = color;
+
+    // Everything the script needs is bounded by the header, and comes out of
+    // the arena, so it can never eat into the LED buffers
+    uint8_t* depths = ledArenaAlloc(arena, vm->codeSize);
+    vm->stack = ledArenaAlloc(arena, vm->stackSize * sizeof(int32_t));
+    vm->vars = vm->varCount > 0 ? ledArenaAlloc(arena, vm->varCount * sizeof(int32_t)) : NULL;
+    if(depths == NULL || vm->stack == NULL || (vm->varCount > 0 && vm->vars == NULL)) {
+        return LED_VM_CANT_ALLOCATE;
+    }
+
+    LedVmStatus status = led_vm_verify(vm, depths);
+    if(status != LED_VM_OK) {
+        return status;
+    }
+    if(vm->vars != NULL) {
+        memset(vm->vars, 0, vm->varCount * sizeof(int32_t));
+    }
+    return LED_VM_OK;
+}
+
+LedVmStatus ledVmLoadFile(LedVm_t* vm, LedArena_t* arena, const char* path, uint32_t color) {
+    Storage* storage = furi_record_open(RECORD_STORAGE);
+    File* file = storage_file_alloc(storage);
+    LedVmStatus status = LED_VM_OK;
+    uint8_t* data = NULL;
+    size_t size = 0;
+    if(!storage_file_open(file, path, FSAM_READ, FSOM_OPEN_EXISTING)) {
+        status = LED_VM_CANT_READ;
+    } else if(storage_file_size(file) > LED_VM_MAX_FILE_SIZE) {
+        // Checked before reading, so a huge file never touches memory
+        status = LED_VM_TOO_LARGE;
+    } else {
+        size = storage_file_size(file);
+        data = ledArenaAlloc(arena, size);
+        if(data == NULL) {
+            status = LED_VM_CANT_ALLOCATE;
+        } else if(storage_file_read(file, data, size) != size) {
+            status = LED_VM_CANT_READ;
+        }
+    }
+    storage_file_close(file);
+    storage_file_free(file);
+    furi_record_close(RECORD_STORAGE);
+
+    if(status != LED_VM_OK) {
+        return status;
+    }
+    return ledVmLoad(vm, arena, data, size, color);
+}
+
+static inline uint8_t led_vm_clamp_channel(int32_t value) {
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+/// @brief A parabola per half wave, close enough to a sine for lights.
+static inline int32_t led_vm_sin(int32_t phase) {
+    const int32_t half = phase & 127;
+    const int32_t height = (half * (128 - half)) >> 5;
+    return led_vm_clamp_channel((phase & 128) ? 128 - height : 128 + height);
+}
+
+static inline int32_t led_vm_hash(int32_t x) {
+    uint32_t hash = (uint32_t)x * 2654435761UL;
+    hash ^= hash >> 15;
+    hash *= 2246822519UL;
+    return hash >> 24;
+}
+
+/// @brief 1D value noise, smoothly blending between a random value every 256 of x.
+static inline int32_t led_vm_noise(int32_t x) {
+    const int32_t cell = x >> 8;
+    const int32_t fraction = x & 255;
+    const int32_t eased = (fraction * fraction * (768 - 2 * fraction)) >> 16;
+    const int32_t from = led_vm_hash(cell);
+    const int32_t to = led_vm_hash(cell + 1);
+    return from + (((to - from) * eased) >> 8);
+}
+
+static inline uint32_t led_vm_lerp_rgb(uint32_t from, uint32_t to, int32_t weight) {
+    uint32_t rgb = 0;
+    for(uint8_t shift = 0; shift < 24; shift += 8) {
+        int32_t fromChannel = (from >> shift) & 0xFF;
+        int32_t toChannel = (to >> shift) & 0xFF;
+        rgb |= (uint32_t)(fromChannel + (((toChannel - fromChannel) * weight) >> 8)) << shift;
+    }
+    return rgb;
+}
+
+static inline uint32_t led_vm_palette_entry(const LedVm_t* vm, uint8_t entry) {
+    const uint8_t* color = &vm->palette[entry * LED_FRAMEBUFFER_BYTES_PER_LED];
+    return (color[0] << 16) | (color[1] << 8) | color[2];
+}
+
+static inline uint32_t led_vm_palette(const LedVm_t* vm, int32_t index) {
+    const uint32_t position = (index & 255) * vm->paletteSize;
+    const uint8_t entry = position >> 8;
+    const uint8_t next = entry + 1 < vm->paletteSize ? entry + 1 : 0;
+    return led_vm_lerp_rgb(
+        led_vm_palette_entry(vm, entry), led_vm_palette_entry(vm, next), position & 255);
+}
+
+static inline void led_vm_write(uint8_t* pixel, uint32_t rgb) {
+    pixel[0] = (rgb >> 16) & 0xFF;
+    pixel[1] = (rgb >> 8) & 0xFF;
+    pixel[2] = rgb & 0xFF;
+}
+
+/// @brief Clips a range of LEDs to the framebuffer.
+/// @return Returns false if none of the range is on the strip.
+static inline bool led_vm_clip(
+    const LedFramebuffer_t* framebuffer,
+    int32_t start,
+    int32_t count,
+    int32_t* first,
+    int32_t* last) {
+    if(count <= 0) {
+        return false;
+    }
+    *first = MAX(start, 0);
+    *last = (int32_t)MIN((int64_t)start + count, (int64_t)framebuffer->count);
+    return *first < *last;
+}
+
+LedVmStatus ledVmRun(LedVm_t* vm, LedFramebuffer_t* framebuffer, uint32_t timeMs) {
+    furi_assert(framebuffer->format == LedPixelFormatRgb);
+    // Threaded dispatch, each instruction jumps straight to the next one's handler
+    static const void* const dispatch[LedVmOpSize] = {
+        [LedVmOpEnd] = &&op_end,
+        [LedVmOpPush8] = &&op_push8,
+        [LedVmOpPush16] = &&op_push16,
+        [LedVmOpPush32] = &&op_push32,
+        [LedVmOpLoad] = &&op_load,
+        [LedVmOpStore] = &&op_store,
+        [LedVmOpDup] = &&op_dup,
+        [LedVmOpDrop] = &&op_drop,
+        [LedVmOpSwap] = &&op_swap,
+        [LedVmOpAdd] = &&op_add,
+        [LedVmOpSub] = &&op_sub,
+        [LedVmOpMul] = &&op_mul,
+        [LedVmOpDiv] = &&op_div,
+        [LedVmOpMod] = &&op_mod,
+        [LedVmOpAnd] = &&op_and,
+        [LedVmOpOr] = &&op_or,
+        [LedVmOpXor] = &&op_xor,
+        [LedVmOpShl] = &&op_shl,
+        [LedVmOpShr] = &&op_shr,
+        [LedVmOpMin] = &&op_min,
+        [LedVmOpMax] = &&op_max,
+        [LedVmOpLt] = &&op_lt,
+        [LedVmOpEq] = &&op_eq,
+        [LedVmOpNeg] = &&op_neg,
+        [LedVmOpNot] = &&op_not,
+        [LedVmOpSin] = &&op_sin,
+        [LedVmOpNoise] = &&op_noise,
+        [LedVmOpTime] = &&op_time,
+        [LedVmOpLedCount] = &&op_led_count,
+        [LedVmOpColor] = &&op_color,
+        [LedVmOpPal] = &&op_pal,
+        [LedVmOpRgb] = &&op_rgb,
+        [LedVmOpSet] = &&op_set,
+        [LedVmOpFill] = &&op_fill,
+        [LedVmOpGradient] = &&op_gradient,
+        [LedVmOpPalRange] = &&op_pal_range,
+        [LedVmOpNoiseRange] = &&op_noise_range,
+        [LedVmOpFade] = &&op_fade,
+        [LedVmOpJump] = &&op_jump,
+        [LedVmOpJumpIfZero] = &&op_jump_if_zero,
+        [LedVmOpLoop] = &&op_loop,
+    };
+// Loading verified every opcode, stack access and jump, so nothing is checked here
+#define LED_VM_NEXT() goto* dispatch[*pc++]
+// Stops the script once it has done more work this frame than it is allowed
+#define LED_VM_CHARGE(amount)        \
+    work += (uint32_t)(amount);      \
+    if(work > LED_VM_MAX_WORK) {     \
+        return LED_VM_TOO_MUCH_WORK; \
+    }
+#define LED_VM_BINARY(expression) \
+    sp--;                         \
+    a = sp[-1];                   \
+    b = sp[0];                    \
+    sp[-1] = (expression);        \
+    LED_VM_NEXT()
+
+    const uint8_t* pc = vm->code;
+    int32_t* sp = vm->stack;
+    int32_t* vars = vm->vars;
+    uint8_t* pixels = framebuffer->pixels;
+    uint32_t work = 0;
+    int32_t a, b, start, count, first, last;
+
+    LED_VM_NEXT();
+
+op_end:
+    return LED_VM_OK;
+op_push8:
+    *sp++ = (int8_t)*pc++;
+    LED_VM_NEXT();
+op_push16:
+    *sp++ = led_vm_read_i16(pc);
+    pc += 2;
+    LED_VM_NEXT();
+op_push32:
+    *sp++ = led_vm_read_i32(pc);
+    pc += 4;
+    LED_VM_NEXT();
+op_load:
+    *sp++ = vars[*pc++];
+    LED_VM_NEXT();
+op_store:
+    vars[*pc++] = *--sp;
+    LED_VM_NEXT();
+op_dup:
+    sp[0] = sp[-1];
+    sp++;
+    LED_VM_NEXT();
+op_drop:
+    sp--;
+    LED_VM_NEXT();
+op_swap:
+    a = sp[-2];
+    sp[-2] = sp[-1];
+    sp[-1] = a;
+    LED_VM_NEXT();
+op_add:
+    LED_VM_BINARY((int32_t)((uint32_t)a + (uint32_t)b));
+op_sub:
+    LED_VM_BINARY((int32_t)((uint32_t)a - (uint32_t)b));
+op_mul:
+    LED_VM_BINARY((int32_t)((uint32_t)a * (uint32_t)b));
+op_div:
+    LED_VM_BINARY(b == 0 || (a == INT32_MIN && b == -1) ? 0 : a / b);
+op_mod:
+    LED_VM_BINARY(b == 0 || (a == INT32_MIN && b == -1) ? 0 : a % b);
+op_and:
+    LED_VM_BINARY(a & b);
+op_or:
+    LED_VM_BINARY(a | b);
+op_xor:
+    LED_VM_BINARY(a ^ b);
+op_shl:
+    LED_VM_BINARY((int32_t)((uint32_t)a << (b & 31)));
+op_shr:
+    LED_VM_BINARY(a >> (b & 31));
+op_min:
+    LED_VM_BINARY(MIN(a, b));
+op_max:
+    LED_VM_BINARY(MAX(a, b));
+op_lt:
+    LED_VM_BINARY(a < b);
+op_eq:
+    LED_VM_BINARY(a == b);
+op_neg:
+    sp[-1] = (int32_t)(0U - (uint32_t)sp[-1]);
+    LED_VM_NEXT();
+op_not:
+    sp[-1] = !sp[-1];
+    LED_VM_NEXT();
+op_sin:
+    sp[-1] = led_vm_sin(sp[-1]);
+    LED_VM_NEXT();
+op_noise:
+    sp[-1] = led_vm_noise(sp[-1]);
+    LED_VM_NEXT();
+op_time:
+    *sp++ = timeMs;
+    LED_VM_NEXT();
+op_led_count:
+    *sp++ = framebuffer->count;
+    LED_VM_NEXT();
+op_color:
+    *sp++ = vm->color;
+    LED_VM_NEXT();
+op_pal:
+    sp[-1] = led_vm_palette(vm, sp[-1]);
+    LED_VM_NEXT();
+op_rgb:
+    sp -= 2;
+    sp[-1] = (led_vm_clamp_channel(sp[-1]) << 16) | (led_vm_clamp_channel(sp[0]) << 8) |
+             led_vm_clamp_channel(sp[1]);
+    LED_VM_NEXT();
+op_set:
+    sp -= 2;
+    if(sp[0] >= 0 && sp[0] < framebuffer->count) {
+        led_vm_write(&pixels[sp[0] * LED_FRAMEBUFFER_BYTES_PER_LED], sp[1]);
+    }
+    LED_VM_NEXT();
+op_fill:
+    // Range ops do a whole run of LEDs per dispatch, like a native effect would
+    sp -= 3;
+    if(led_vm_clip(framebuffer, sp[0], sp[1], &first, &last)) {
+        LED_VM_CHARGE(last - first);
+        for(int32_t i = first; i < last; i++) {
+            led_vm_write(&pixels[i * LED_FRAMEBUFFER_BYTES_PER_LED], sp[2]);
+        }
+    }
+    LED_VM_NEXT();
+op_gradient:
+    sp -= 4;
+    start = sp[0];
+    count = sp[1];
+    if(led_vm_clip(framebuffer, start, count, &first, &last)) {
+        LED_VM_CHARGE(last - first);
+        for(int32_t i = first; i < last; i++) {
+            const int32_t weight =
+                count > 1 ? (((int64_t)i - start) * 256) / ((int64_t)count - 1) : 0;
+            led_vm_write(
+                &pixels[i * LED_FRAMEBUFFER_BYTES_PER_LED],
+                led_vm_lerp_rgb(sp[2], sp[3], weight));
+        }
+    }
+    LED_VM_NEXT();
+op_pal_range:
+    sp -= 4;
+    start = sp[0];
+    if(led_vm_clip(framebuffer, start, sp[1], &first, &last)) {
+        LED_VM_CHARGE(last - first);
+        // Wrapping is fine, only the bottom byte picks the color
+        uint32_t index = (uint32_t)sp[2] + (uint32_t)((int64_t)first - start) * (uint32_t)sp[3];
+        for(int32_t i = first; i < last; i++) {
+            led_vm_write(&pixels[i * LED_FRAMEBUFFER_BYTES_PER_LED], led_vm_palette(vm, index));
+            index += sp[3];
+        }
+    }
+    LED_VM_NEXT();
+op_noise_range:
+    sp -= 4;
+    start = sp[0];
+    if(led_vm_clip(framebuffer, start, sp[1], &first, &last)) {
+        LED_VM_CHARGE(last - first);
+        uint32_t x = (uint32_t)sp[2] + (uint32_t)((int64_t)first - start) * (uint32_t)sp[3];
+        for(int32_t i = first; i < last; i++) {
+            led_vm_write(
+                &pixels[i * LED_FRAMEBUFFER_BYTES_PER_LED],
+                led_vm_palette(vm, led_vm_noise((int32_t)x)));
+            x += sp[3];
+        }
+    }
+    LED_VM_NEXT();
+op_fade:
+    sp -= 3;
+    if(led_vm_clip(framebuffer, sp[0], sp[1], &first, &last)) {
+        LED_VM_CHARGE(last - first);
+        const int32_t amount = CLAMP(sp[2], 256, 0);
+        uint8_t* channel = &pixels[first * LED_FRAMEBUFFER_BYTES_PER_LED];
+        uint8_t* end = &pixels[last * LED_FRAMEBUFFER_BYTES_PER_LED];
+        for(; channel < end; channel++) {
+            *channel = (*channel * amount) >> 8;
+        }
+    }
+    LED_VM_NEXT();
+op_jump:
+    a = led_vm_read_i16(pc);
+    pc += 2;
+    if(a < 0) {
+        LED_VM_CHARGE(-a);
+    }
+    pc += a;
+    LED_VM_NEXT();
+op_jump_if_zero:
+    a = led_vm_read_i16(pc);
+    pc += 2;
+    if(*--sp == 0) {
+        if(a < 0) {
+            LED_VM_CHARGE(-a);
+        }
+        pc += a;
+    }
+    LED_VM_NEXT();
+op_loop:
+    a = led_vm_read_i16(pc + 2);
+    vars[pc[0]] = (int32_t)((uint32_t)vars[pc[0]] + 1);
+    b = vars[pc[0]] < vars[pc[1]];
+    pc += 4;
+    if(b) {
+        if(a < 0) {
+            LED_VM_CHARGE(-a);
+        }
+        pc += a;
+    }
+    LED_VM_NEXT();
+
+#undef LED_VM_BINARY
+#undef LED_VM_CHARGE
+#undef LED_VM_NEXT
+}
@@ -0,0 +1,143 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "led_arena.h"
+#include "led_framebuffer.h"
+
+/// @brief Limits on what a script may ask for, checked when it is loaded.
+#define LED_VM_MAX_FILE_SIZE 1024
+#define LED_VM_MAX_STACK 32
+#define LED_VM_MAX_VARS 16
+#define LED_VM_MAX_PALETTE 16
+/// @brief The most work a script may do per frame. Every pass of a loop costs
+/// the size of its body in bytes, which is at least as many instructions as
+/// it runs, and every LED a range op writes costs 1.
+#define LED_VM_MAX_WORK 100000
+
+/// @brief The size of the file header: magic, stack size, variable count,
+/// palette size, a reserved byte and the code size.
+#define LED_VM_HEADER_SIZE 10
+#define LED_VM_MAGIC "LVM1"
+
+/// @brief The space a script can take up in an arena, no matter what is in it.
+#define LED_VM_ARENA_SIZE                                                            \
+    (LED_VM_MAX_FILE_SIZE + LED_VM_MAX_FILE_SIZE + LED_VM_MAX_STACK * sizeof(int32_t) + \
+     LED_VM_MAX_VARS * sizeof(int32_t) + 4 * LED_ARENA_ALIGNMENT)
+
+/// @brief An enum to define different result statuses for functions
+/// regarding the effect VM.
+typedef enum {
+    LED_VM_OK = 0,
+    LED_VM_CANT_READ = -1,
+    LED_VM_TOO_LARGE = -2,
+    LED_VM_BAD_HEADER = -3,
+    LED_VM_BAD_OPCODE = -4,
+    LED_VM_BAD_VARIABLE = -5,
+    LED_VM_BAD_JUMP = -6,
+    LED_VM_BAD_STACK = -7,
+    LED_VM_NO_PALETTE = -8,
+    LED_VM_CANT_ALLOCATE = -9,
+    LED_VM_TOO_MUCH_WORK = -10,
+} LedVmStatus;
+
+/// @brief The instructions a script is made of. Values are signed 32 bit
+/// integers and colors are packed as 0xRRGGBB. Operands are listed in the
+/// order they are pushed, and immediates follow the opcode little endian.
+/// tools/led_vm.py compiles scripts into these, and must be kept in sync.
+typedef enum {
+    LedVmOpEnd, // Ends the frame
+    LedVmOpPush8, // i8 immediate -> value
+    LedVmOpPush16, // i16 immediate -> value
+    LedVmOpPush32, // i32 immediate -> value
+    LedVmOpLoad, // u8 variable immediate -> value
+    LedVmOpStore, // value, u8 variable immediate
+    LedVmOpDup, // a -> a a
+    LedVmOpDrop, // a ->
+    LedVmOpSwap, // a b -> b a
+    LedVmOpAdd, // a b -> a + b, and likewise for the rest of the math
+    LedVmOpSub,
+    LedVmOpMul,
+    LedVmOpDiv, // Dividing by 0 gives 0
+    LedVmOpMod, // Dividing by 0 gives 0
+    LedVmOpAnd,
+    LedVmOpOr,
+    LedVmOpXor,
+    LedVmOpShl, // Only the low 5 bits of the shift are used
+    LedVmOpShr, // Arithmetic shift
+    LedVmOpMin,
+    LedVmOpMax,
+    LedVmOpLt, // a b -> 1 if a < b, otherwise 0
+    LedVmOpEq, // a b -> 1 if a == b, otherwise 0
+    LedVmOpNeg, // a -> -a
+    LedVmOpNot, // a -> 1 if a is 0, otherwise 0
+    LedVmOpSin, // phase -> 0 to 255, one wave for every 256 of phase
+    LedVmOpNoise, // x -> 0 to 255, smooth noise with a new value every 256 of x
+    LedVmOpTime, // -> ms since the effect started
+    LedVmOpLedCount, // -> number of LEDs
+    LedVmOpColor, // -> the color picked in the app
+    LedVmOpPal, // index -> color, blending across the palette every 256 of index
+    LedVmOpRgb, // r g b -> color, each channel clamped to 0 to 255
+    LedVmOpSet, // index color -> sets a single LED
+    LedVmOpFill, // start count color -> sets a range of LEDs
+    LedVmOpGradient, // start count from to -> blends a range of LEDs between two colors
+    LedVmOpPalRange, // start count index step -> LED i gets pal(index + i * step)
+    LedVmOpNoiseRange, // start count x step -> LED i gets pal(noise(x + i * step))
+    LedVmOpFade, // start count amount -> scales a range of LEDs by amount / 256
+    LedVmOpJump, // i16 immediate offset from the next instruction
+    LedVmOpJumpIfZero, // value, i16 immediate offset from the next instruction
+    // u8 counter variable, u8 end variable, i16 offset: adds 1 to the counter
+    // and jumps while it is below the end, so a loop costs one dispatch per pass
+    LedVmOpLoop,
+    LedVmOpSize,
+} LedVmOp;
+
+/// @brief A verified script, ready to run.
+typedef struct {
+    const uint8_t* code;
+    uint16_t codeSize;
+    // Packed RGB, 3 bytes per entry.
+    const uint8_t* palette;
+    uint8_t paletteSize;
+    int32_t* stack;
+    uint8_t stackSize;
+    // Kept from one frame to the next, so scripts can hold state.
+    int32_t* vars;
+    uint8_t varCount;
+    // The color picked in the app, for LedVmOpColor.
+    uint32_t color;
+} LedVm_t;
+
+/// @brief Verifies a script and gets it ready to run. Every stack access,
+/// variable and jump is checked here, so running it needs no checks of its own,
+/// and everything it uses comes out of the arena.
+/// @param vm The VM to load into.
+/// @param arena The arena to allocate the stack and variables from.
+/// @param data The script, which must stay valid while the VM is used.
+/// @param size The size in bytes of the script.
+/// @param color The color picked in the app, for the script to use.
+/// @return Returns LED_VM_OK on success, otherwise why the script was rejected.
+LedVmStatus ledVmLoad(
+    LedVm_t* vm,
+    LedArena_t* arena,
+    const uint8_t* data,
+    size_t size,
+    uint32_t color);
+
+/// @brief Reads a script from storage into the arena, then verifies it with ledVmLoad.
+/// @param vm The VM to load into.
+/// @param arena The arena to read the script into and allocate from.
+/// @param path The path of the script on storage.
+/// @param color The color picked in the app, for the script to use.
+/// @return Returns LED_VM_OK on success, otherwise why the script was rejected.
+LedVmStatus ledVmLoadFile(LedVm_t* vm, LedArena_t* arena, const char* path, uint32_t color);
+
+/// @brief Runs the script once to draw a frame.
+/// @param vm The loaded VM to run.
+/// @param framebuffer The RGB framebuffer to draw into.
+/// @param timeMs The time since the effect started.
+/// @return Returns LED_VM_OK on success, LED_VM_TOO_MUCH_WORK if the script
+/// was stopped for going over LED_VM_MAX_WORK.
+LedVmStatus ledVmRun(LedVm_t* vm, LedFramebuffer_t* framebuffer, uint32_t timeMs);
@@ -0,0 +1,767 @@
+#include <furi.h>
+#include <furi_hal.h>
+#include <furi_hal_power.h>
+#include <storage/storage.h>
+
+#include "led_worker.h"
+#include "led_arena.h"
+#include "led_framebuffer.h"
+#include "led_sequencer.h"
+#include "led_pwm.h"
+#include "led_governor.h"
+#include "led_preview.h"
+#include "led_vm.h"
+#include "led_sprite.h"
+#include "gpio_helper.h"
+
+#define LED_WORKER_STACK_SIZE (4 * 1024)
+// Effect scratch space is a frame's worth of pixels on top of a fixed base.
+#define LED_WORKER_SCRATCH_BASE_SIZE 1024
+// The demo show cycles between keyframes built from the selected color.
+#define LED_WORKER_SHOW_KEYFRAMES 6
+#define LED_WORKER_SHOW_HOLD_MS 1000
+#define LED_WORKER_SHOW_FADE_MS 1500
+// How often the palette is rotated by one entry in palette mode.
+#define LED_WORKER_PALETTE_STEP_MS 80
+// Sprite mode lays the strip out as a serpentine matrix this many rows tall,
+// and scrolls the sprites across it by a column every step.
+#define LED_WORKER_MATRIX_HEIGHT 8
+#define LED_WORKER_SPRITE_STEP_MS 100
+// How long the worker can go between reads of the cycle counter before it may have wrapped.
+#define LED_WORKER_CLOCK_WRAP_MS 30000
+// Script mode runs the effect compiled by tools/led_vm.py from here.
+#define LED_WORKER_SCRIPT_PATH APP_DATA_PATH("effect.lvm")
+
+typedef enum {
+    LedWorkerFlagUpdate = (1 << 0),
+    LedWorkerFlagStop = (1 << 1),
+} LedWorkerFlag;
+
+#define LED_WORKER_FLAGS_ALL (LedWorkerFlagUpdate | LedWorkerFlagStop)
+
+struct LedWorker {
+    FuriThread* thread;
+    // Guards the pending command, which is the only state shared with the GUI thread.
+    FuriMutex* mutex;
+    LedCommand_t pending;
+    bool hasPending;
+    // Written by the worker under the mutex so fit checks can account for it.
+    size_t arenaCapacity;
+    LedWorkerRateCallback rateCallback;
+    void* rateCallbackContext;
+    LedWorkerErrorCallback errorCallback;
+    void* errorCallbackContext;
+    LedPreview_t* pendingPreview;
+
+    // Only touched from the worker thread.
+    LedCommand_t active;
+    bool hasActive;
+
+    // Every LED buffer is carved out of the arena, which is only rebuilt
+    // when the LED count or type changes.
+    LedArena_t arena;
+    uint16_t arenaLedCount;
+    LedType arenaLedType;
+    LedMode arenaLedMode;
+    LedFramebuffer_t framebuffer;
+    uint16_t* timerBuffer;
+    // Effects and shows build whatever they need in here, and reset it when they change.
+    LedArena_t scratch;
+
+    // The worker's own clock. The tick stops while frames are sent with
+    // interrupts masked, so effects and pacing use the cycle counter instead.
+    uint32_t clockMs;
+    uint32_t clockCycles;
+    uint32_t clockTick;
+
+    // State for whichever effect the current mode plays.
+    LedSequencer_t sequencer;
+    LedVm_t vm;
+    LedMatrix_t matrix;
+    bool effectReady;
+    uint32_t effectStartMs;
+    uint32_t paletteMs;
+
+    // Picks how often effects are rendered from how long their frames take.
+    LedGovernor_t governor;
+    uint32_t lastFrameMs;
+    // The frame rate last passed to the rate callback, 0 when nothing is animating.
+    uint32_t reportedFps;
+    // Where to publish what the strip is showing, picked up from pendingPreview.
+    LedPreview_t* preview;
+
+    // What the strip is currently showing, so unchanged frames can be skipped.
+    uint32_t sentHash;
+    bool sentValid;
+    uint32_t lastSendMs;
+
+    // Kept to see how much work skipping unchanged frames saves.
+    uint32_t framesSent;
+    uint32_t framesSkipped;
+    // Kept on the worker's clock, so the time spent sending with the tick
+    // stopped is counted.
+    uint32_t busyMs;
+    uint32_t startMs;
+};
+
+static LedPixelFormat led_worker_pixel_format(LedMode ledMode) {
+    // Palette mode only needs half a byte per LED
+    return ledMode == LedModePalette ? LedPixelFormatIndexed4 : LedPixelFormatRgb;
+}
+
+/// @brief Gets the time in milliseconds on the worker's clock.
+static uint32_t led_worker_now_ms(LedWorker_t* worker) {
+    const uint32_t cyclesPerMs = SystemCoreClock / 1000U;
+    const uint32_t tick = furi_get_tick();
+    const uint32_t elapsedTicks = tick - worker->clockTick;
+    worker->clockTick = tick;
+    if(elapsedTicks >= LED_WORKER_CLOCK_WRAP_MS) {
+        // Nothing was sent during a sleep this long, so the tick kept up
+        worker->clockMs += elapsedTicks;
+        worker->clockCycles = DWT->CYCCNT;
+        return worker->clockMs;
+    }
+    const uint32_t elapsedMs = (DWT->CYCCNT - worker->clockCycles) / cyclesPerMs;
+    worker->clockMs += elapsedMs;
+    // Keep the leftover cycles so the clock doesn't drift
+    worker->clockCycles += elapsedMs * cyclesPerMs;
+    return worker->clockMs;
+}
+
+static uint16_t led_worker_buffer_led_count(uint16_t ledCount, LedType ledType) {
+    // A circuit is a single light no matter how many LEDs were picked
+    return ledType == SingleLED ? 1 : ledCount;
+}
+
+static size_t led_worker_scratch_size(uint16_t ledCount, LedMode ledMode) {
+    size_t size = LED_WORKER_SCRATCH_BASE_SIZE;
+    if(ledMode == LedModeShow) {
+        // Room for the show's gradient frame
+        size += ledFramebufferArenaSize(LedPixelFormatRgb, ledCount);
+    } else if(ledMode == LedModeScript) {
+        // However big a script is, it can never take more than this
+        size += LED_VM_ARENA_SIZE;
+    }
+    return size;
+}
+
+size_t ledWorkerRequiredMemory(uint16_t ledCount, LedType ledType, LedMode ledMode) {
+    ledCount = led_worker_buffer_led_count(ledCount, ledType);
+    size_t size = ledFramebufferArenaSize(led_worker_pixel_format(ledMode), ledCount);
+    if(ledType == WS2812B) {
+        size += ledArenaAlignSize(ws2812bTimerBufferLength(ledCount) * sizeof(uint16_t));
+    }
+    size += ledArenaAlignSize(led_worker_scratch_size(ledCount, ledMode));
+    return size;
+}
+
+bool ledWorkerConfigFits(
+    LedWorker_t* worker,
+    uint16_t ledCount,
+    LedType ledType,
+    LedMode ledMode) {
+    furi_check(furi_mutex_acquire(worker->mutex, FuriWaitForever) == FuriStatusOk);
+    size_t reclaimable = worker->arenaCapacity;
+    furi_mutex_release(worker->mutex);
+    return ledArenaFits(ledWorkerRequiredMemory(ledCount, ledType, ledMode), reclaimable);
+}
+
+static void led_worker_set_arena_capacity(LedWorker_t* worker, size_t capacity) {
+    furi_check(furi_mutex_acquire(worker->mutex, FuriWaitForever) == FuriStatusOk);
+    worker->arenaCapacity = capacity;
+    furi_mutex_release(worker->mutex);
+}
+
+static void led_worker_release_arena(LedWorker_t* worker) {
+    ledArenaFree(&worker->arena);
+    led_worker_set_arena_capacity(worker, 0);
+    worker->framebuffer = (LedFramebuffer_t){0};
+    worker->timerBuffer = NULL;
+    worker->scratch = (LedArena_t){0};
+    worker->effectReady = false;
+    worker->sentValid = false;
+}
+
+/// @brief Makes sure the arena is laid out for the command's strip, rebuilding it if needed.
+static bool led_worker_prepare_arena(LedWorker_t* worker, const LedCommand_t* command) {
+    const uint16_t ledCount = led_worker_buffer_led_count(command->ledCount, command->ledType);
+    if(worker->arena.base != NULL && worker->arenaLedCount == ledCount &&
+       worker->arenaLedType == command->ledType && worker->arenaLedMode == command->ledMode) {
+        return true;
+    }
+
+    led_worker_release_arena(worker);
+    if(ledArenaInit(
+           &worker->arena,
+           ledWorkerRequiredMemory(ledCount, command->ledType, command->ledMode)) !=
+       LED_ARENA_OK) {
+        return false;
+    }
+    led_worker_set_arena_capacity(worker, worker->arena.capacity);
+
+    bool allocated = ledFramebufferInit(
+        &worker->framebuffer,
+        &worker->arena,
+        led_worker_pixel_format(command->ledMode),
+        ledCount);
+    if(allocated && command->ledType == WS2812B) {
+        worker->timerBuffer = ledArenaAlloc(
+            &worker->arena, ws2812bTimerBufferLength(ledCount) * sizeof(uint16_t));
+        allocated = worker->timerBuffer != NULL;
+    }
+    if(allocated) {
+        allocated = ledArenaSplit(
+            &worker->arena,
+            &worker->scratch,
+            led_worker_scratch_size(ledCount, command->ledMode));
+    }
+    if(!allocated) {
+        led_worker_release_arena(worker);
+        return false;
+    }
+
+    worker->arenaLedCount = ledCount;
+    worker->arenaLedType = command->ledType;
+    worker->arenaLedMode = command->ledMode;
+    return true;
+}
+
+/// @brief Builds the demo show, which holds and crossfades between colors
+/// derived from the command's color, with a gradient frame in between.
+static bool led_worker_build_show(LedWorker_t* worker, const LedCommand_t* command) {
+    ledArenaReset(&worker->scratch);
+    if(!ledSequencerInit(&worker->sequencer, &worker->scratch, LED_WORKER_SHOW_KEYFRAMES, true)) {
+        return false;
+    }
+
+    LedFramebuffer_t gradient;
+    if(!ledFramebufferInit(&gradient, &worker->scratch, LedPixelFormatRgb, command->ledCount)) {
+        return false;
+    }
+    // Rotate the channels to get the next color, eg. red to green
+    const uint32_t from = command->rgb;
+    const uint32_t to = ((from << 8) | (from >> 16)) & 0xFFFFFF;
+    for(uint16_t i = 0; i < gradient.count; i++) {
+        uint32_t weight = gradient.count > 1 ? (i * 256U) / (gradient.count - 1) : 0;
+        uint8_t* pixel = &gradient.pixels[i * LED_FRAMEBUFFER_BYTES_PER_LED];
+        for(uint8_t c = 0; c < LED_FRAMEBUFFER_BYTES_PER_LED; c++) {
+            int32_t shift = 16 - 8 * c;
+            int32_t fromChannel = (from >> shift) & 0xFF;
+            int32_t toChannel = (to >> shift) & 0xFF;
+            pixel[c] = fromChannel + (((toChannel - fromChannel) * (int32_t)weight) >> 8);
+        }
+    }
+
+    const LedKeyframe_t keyframes[LED_WORKER_SHOW_KEYFRAMES] = {
+        {.type = LedKeyframeColor, .rgb = from, .durationMs = LED_WORKER_SHOW_HOLD_MS},
+        {.type = LedKeyframeColor,
+         .rgb = from,
+         .durationMs = LED_WORKER_SHOW_FADE_MS,
+         .easing = LedEasingEaseInOut},
+        {.type = LedKeyframeFrame,
+         .pixels = gradient.pixels,
+         .durationMs = LED_WORKER_SHOW_HOLD_MS},
+        {.type = LedKeyframeFrame,
+         .pixels = gradient.pixels,
+         .durationMs = LED_WORKER_SHOW_FADE_MS,
+         .easing = LedEasingEaseInOut},
+        {.type = LedKeyframeColor, .rgb = to, .durationMs = LED_WORKER_SHOW_HOLD_MS},
+        {.type = LedKeyframeColor,
+         .rgb = to,
+         .durationMs = LED_WORKER_SHOW_FADE_MS,
+         .easing = LedEasingLinear},
+    };
+    for(uint8_t i = 0; i < LED_WORKER_SHOW_KEYFRAMES; i++) {
+        ledSequencerAdd(&worker->sequencer, &keyframes[i]);
+    }
+    return true;
+}
+
+/// @brief Builds the palette effect, where every LED uses one of 16 entries
+/// ramping from the command's color to the next one and back.
+static bool led_worker_build_palette(LedWorker_t* worker, const LedCommand_t* command) {
+    LedFramebuffer_t* framebuffer = &worker->framebuffer;
+    const uint32_t from = command->rgb;
+    const uint32_t to = ((from << 8) | (from >> 16)) & 0xFFFFFF;
+    const uint16_t half = framebuffer->paletteSize / 2;
+    for(uint16_t i = 0; i < framebuffer->paletteSize; i++) {
+        // Triangle wave so that rotating the palette loops smoothly
+        int32_t weight = ((i < half ? i : framebuffer->paletteSize - i) * 256) / half;
+        uint32_t rgb = 0;
+        for(uint8_t shift = 0; shift < 24; shift += 8) {
+            int32_t fromChannel = (from >> shift) & 0xFF;
+            int32_t toChannel = (to >> shift) & 0xFF;
+            rgb |= (uint32_t)(fromChannel + (((toChannel - fromChannel) * weight) >> 8)) << shift;
+        }
+        ledFramebufferSetPaletteEntry(framebuffer, i, rgb);
+    }
+    for(uint16_t i = 0; i < framebuffer->count; i++) {
+        ledFramebufferSetIndex(framebuffer, i, i % framebuffer->paletteSize);
+    }
+    worker->paletteMs = led_worker_now_ms(worker);
+    return true;
+}
+
+/// @brief Lets the error callback know an effect can't be played.
+static void led_worker_report_error(LedWorker_t* worker, LedWorkerError error) {
+    furi_check(furi_mutex_acquire(worker->mutex, FuriWaitForever) == FuriStatusOk);
+    LedWorkerErrorCallback callback = worker->errorCallback;
+    void* context = worker->errorCallbackContext;
+    furi_mutex_release(worker->mutex);
+    if(callback != NULL) {
+        callback(error, context);
+    }
+}
+
+/// @brief Loads the effect script from the SD card. Scripts are verified as
+/// they load, and only ever get the scratch space, never the LED buffers.
+static bool led_worker_build_script(LedWorker_t* worker, const LedCommand_t* command) {
+    ledArenaReset(&worker->scratch);
+    LedVmStatus status =
+        ledVmLoadFile(&worker->vm, &worker->scratch, LED_WORKER_SCRIPT_PATH, command->rgb);
+    if(status != LED_VM_OK) {
+        FURI_LOG_E(TAG, "Can't load effect script %s (%d)", LED_WORKER_SCRIPT_PATH, status);
+        ledFramebufferFill(&worker->framebuffer, 0);
+        led_worker_report_error(worker, LedWorkerErrorScriptLoad);
+        return false;
+    }
+    return true;
+}
+
+/// @brief Lays the strip out as a matrix for the sprites to scroll across.
+static bool led_worker_build_sprites(LedWorker_t* worker) {
+    if(ledSpriteCount == 0) {
+        return false;
+    }
+    const uint8_t height = MIN(worker->framebuffer.count, LED_WORKER_MATRIX_HEIGHT);
+    const uint8_t width = MIN(worker->framebuffer.count / height, UINT8_MAX);
+    return ledMatrixInit(
+        &worker->matrix, &worker->framebuffer, width, height, LedMatrixLayoutSerpentine);
+}
+
+/// @brief Scrolls each sprite in from the right and all the way off the left,
+/// one after the other, like a marquee.
+static void led_worker_render_sprites(LedWorker_t* worker, uint32_t timeMs) {
+    const LedMatrix_t* matrix = &worker->matrix;
+    uint32_t cycleSteps = 0;
+    for(size_t i = 0; i < ledSpriteCount; i++) {
+        cycleSteps += matrix->width + ledSprites[i]->width;
+    }
+    uint32_t step = (timeMs / LED_WORKER_SPRITE_STEP_MS) % cycleSteps;
+    size_t index = 0;
+    while(step >= (uint32_t)matrix->width + ledSprites[index]->width) {
+        step -= matrix->width + ledSprites[index]->width;
+        index++;
+    }
+
+    const LedSprite_t* sprite = ledSprites[index];
+    ledFramebufferFill(&worker->framebuffer, 0);
+    ledSpriteBlit(
+        matrix,
+        sprite,
+        (int16_t)matrix->width - (int16_t)step,
+        ((int16_t)matrix->height - sprite->height) / 2);
+}
+
+static bool led_worker_build_effect(LedWorker_t* worker, const LedCommand_t* command) {
+    switch(command->ledMode) {
+    case LedModeShow:
+        return led_worker_build_show(worker, command);
+    case LedModePalette:
+        return led_worker_build_palette(worker, command);
+    case LedModeScript:
+        return led_worker_build_script(worker, command);
+    case LedModeSprite:
+        return led_worker_build_sprites(worker);
+    default:
+        return false;
+    }
+}
+
+/// @brief Renders the current effect into the framebuffer.
+/// @return How long rendering took in microseconds.
+static uint32_t led_worker_render_effect(LedWorker_t* worker, LedMode ledMode) {
+    if(!worker->effectReady) {
+        return 0;
+    }
+    const uint32_t start = DWT->CYCCNT;
+    // Effects play in real time, no matter how many frames actually get sent
+    const uint32_t now = led_worker_now_ms(worker);
+    if(ledMode == LedModeShow) {
+        ledSequencerRender(
+            &worker->sequencer, now - worker->effectStartMs, &worker->framebuffer);
+    } else if(ledMode == LedModePalette) {
+        // Rotating the palette animates every LED while only touching 16 entries
+        const uint32_t steps = (now - worker->paletteMs) / LED_WORKER_PALETTE_STEP_MS;
+        for(uint32_t i = 0; i < steps % worker->framebuffer.paletteSize; i++) {
+            ledFramebufferRotatePalette(&worker->framebuffer, 0, worker->framebuffer.paletteSize);
+        }
+        worker->paletteMs += steps * LED_WORKER_PALETTE_STEP_MS;
+    } else if(ledMode == LedModeScript) {
+        LedVmStatus status =
+            ledVmRun(&worker->vm, &worker->framebuffer, now - worker->effectStartMs);
+        if(status != LED_VM_OK) {
+            FURI_LOG_E(TAG, "Effect script stopped (%d)", status);
+            worker->effectReady = false;
+            // Don't send whatever the script had drawn when it was stopped
+            ledFramebufferFill(&worker->framebuffer, 0);
+            led_worker_report_error(worker, LedWorkerErrorScriptRun);
+        }
+    } else if(ledMode == LedModeSprite) {
+        led_worker_render_sprites(worker, now - worker->effectStartMs);
+    }
+    worker->lastFrameMs = now;
+    return (DWT->CYCCNT - start) / (SystemCoreClock / 1000000U);
+}
+
+static bool led_worker_is_streaming(const LedWorker_t* worker) {
+    return worker->hasActive && worker->active.enabled && worker->active.ledType == WS2812B;
+}
+
+/// @brief Gets what the LEDs are currently showing, for the preview.
+/// @return The frame, or NULL if they are off.
+static const LedFramebuffer_t* led_worker_shown_frame(const LedWorker_t* worker) {
+    if(led_worker_is_streaming(worker)) {
+        return worker->sentValid ? &worker->framebuffer : NULL;
+    }
+    const bool circuitOn = worker->hasActive && worker->active.enabled &&
+                           worker->active.ledType == SingleLED;
+    return circuitOn ? &worker->framebuffer : NULL;
+}
+
+static bool led_worker_is_animating(const LedWorker_t* worker) {
+    return led_worker_is_streaming(worker) && worker->active.ledMode != LedModeSolid &&
+           worker->effectReady;
+}
+
+/// @brief Lets the rate callback know when the frame rate effects are rendered at changes.
+static void led_worker_report_rate(LedWorker_t* worker) {
+    const uint32_t fps = led_worker_is_animating(worker) ? worker->governor.fps : 0;
+    if(fps == worker->reportedFps) {
+        return;
+    }
+    worker->reportedFps = fps;
+
+    furi_check(furi_mutex_acquire(worker->mutex, FuriWaitForever) == FuriStatusOk);
+    LedWorkerRateCallback callback = worker->rateCallback;
+    void* context = worker->rateCallbackContext;
+    furi_mutex_release(worker->mutex);
+    if(callback != NULL) {
+        callback(fps, context);
+    }
+}
+
+/// @brief Publishes what the strip is showing to the preview, if there is one.
+/// @param framebuffer The frame on the strip, or NULL if it is off.
+static void led_worker_publish_preview(LedWorker_t* worker, const LedFramebuffer_t* framebuffer) {
+    if(worker->preview != NULL) {
+        ledPreviewPublish(worker->preview, framebuffer);
+    }
+}
+
+/// @brief Sends the framebuffer, unless the strip is already showing it.
+/// @param timing If not NULL, gets how long encoding and sending took, both 0 when skipped.
+/// @return Returns true if the frame was sent.
+static bool led_worker_send(
+    LedWorker_t* worker,
+    const GpioPin* gpioPin,
+    bool force,
+    LedFrameTiming_t* timing) {
+    uint32_t hash = ledFramebufferHash(&worker->framebuffer);
+    if(!force && worker->sentValid && hash == worker->sentHash) {
+        worker->framesSkipped++;
+        return false;
+    }
+    sendFrameToWS2812B(gpioPin, &worker->framebuffer, worker->timerBuffer, timing);
+    worker->sentHash = hash;
+    worker->sentValid = true;
+    worker->lastSendMs = led_worker_now_ms(worker);
+    worker->framesSent++;
+    led_worker_publish_preview(worker, &worker->framebuffer);
+    return true;
+}
+
+/// @brief Works out how long the worker can sleep before the strip needs
+/// updating again, either for the effect's next change or a keep-alive resend.
+/// Effects are never rendered faster than the governor's frame rate.
+static uint32_t led_worker_next_wakeup_ms(LedWorker_t* worker) {
+    if(!led_worker_is_streaming(worker)) {
+        return FuriWaitForever;
+    }
+
+    const uint32_t now = led_worker_now_ms(worker);
+    uint32_t wait = FuriWaitForever;
+    if(worker->active.ledMode == LedModeShow && worker->effectReady) {
+        uint32_t untilChange =
+            ledSequencerNextChangeMs(&worker->sequencer, now - worker->effectStartMs);
+        if(untilChange != UINT32_MAX) {
+            wait = untilChange;
+        }
+    } else if(worker->active.ledMode == LedModePalette && worker->effectReady) {
+        uint32_t sinceStep = now - worker->paletteMs;
+        wait = sinceStep < LED_WORKER_PALETTE_STEP_MS ? LED_WORKER_PALETTE_STEP_MS - sinceStep : 0;
+    } else if(worker->active.ledMode == LedModeSprite && worker->effectReady) {
+        uint32_t sinceStep = (now - worker->effectStartMs) % LED_WORKER_SPRITE_STEP_MS;
+        wait = LED_WORKER_SPRITE_STEP_MS - sinceStep;
+    } else if(worker->active.ledMode == LedModeScript && worker->effectReady) {
+        // Scripts can change every frame, so run them as often as the governor allows
+        wait = 0;
+    }
+    if(wait != FuriWaitForever) {
+        uint32_t intervalMs = ledGovernorFrameIntervalMs(&worker->governor);
+        uint32_t sinceFrame = now - worker->lastFrameMs;
+        wait = MAX(wait, sinceFrame < intervalMs ? intervalMs - sinceFrame : 0);
+    }
+    if(worker->active.keepAliveMs > 0) {
+        uint32_t sinceSend = now - worker->lastSendMs;
+        uint32_t untilKeepAlive =
+            sinceSend < worker->active.keepAliveMs ? worker->active.keepAliveMs - sinceSend : 0;
+        wait = MIN(wait, untilKeepAlive);
+    }
+    return wait;
+}
+
+/// @brief Renders and sends the next frame when the worker wakes up on its own.
+static void led_worker_refresh(LedWorker_t* worker) {
+    if(!led_worker_is_streaming(worker)) {
+        return;
+    }
+    LedFrameTiming_t timing = {0};
+    const bool animating = led_worker_is_animating(worker);
+    if(animating) {
+        timing.renderUs = led_worker_render_effect(worker, worker->active.ledMode);
+    }
+    bool keepAlive = worker->active.keepAliveMs > 0 &&
+                     led_worker_now_ms(worker) - worker->lastSendMs >= worker->active.keepAliveMs;
+    const bool sent = led_worker_send(worker, worker->active.gpioPin, keepAlive, &timing);
+    if(animating) {
+        // Skipped frames were still rendered, but say nothing about sending
+        ledGovernorRecord(&worker->governor, &timing, sent);
+    }
+    led_worker_report_rate(worker);
+}
+
+static void led_worker_turn_off(LedWorker_t* worker, const LedCommand_t* command) {
+    worker->sentValid = false;
+    led_worker_publish_preview(worker, NULL);
+    ledPwmStop(command->gpioPin);
+    if(furi_hal_power_is_otg_enabled()) {
+        furi_hal_power_disable_otg();
+    }
+}
+
+static void led_worker_apply(LedWorker_t* worker, const LedCommand_t* command) {
+    if(worker->hasActive) {
+        const LedCommand_t* active = &worker->active;
+        if(active->ledType != command->ledType || active->enabled != command->enabled) {
+            // Always power cycle to clear the previous lights
+            led_worker_turn_off(worker, active);
+        } else if(active->gpioPin != command->gpioPin) {
+            ledPwmStop(active->gpioPin);
+            // The new pin's strip has not been sent anything yet
+            worker->sentValid = false;
+        }
+    }
+
+    if(!led_worker_prepare_arena(worker, command)) {
+        FURI_LOG_E(TAG, "Not enough memory to drive %u LEDs", command->ledCount);
+        led_worker_turn_off(worker, command);
+        worker->hasActive = false;
+        led_worker_report_rate(worker);
+        return;
+    }
+
+    switch(command->ledType) {
+    case SingleLED:
+        // Dimming is done by the timers, so this costs nothing once it is set
+        if(command->enabled) {
+            uint8_t level = command->brightness;
+            if(!ledPwmSet(command->gpioPin, level)) {
+                FURI_LOG_W(TAG, "No timer free to dim the LED, it is fully on instead");
+                level = UINT8_MAX;
+            }
+            // The preview shows the circuit as a single LED at its brightness
+            ledFramebufferFill(&worker->framebuffer, level * 0x010101U);
+            led_worker_publish_preview(worker, &worker->framebuffer);
+        } else {
+            ledPwmSet(command->gpioPin, 0);
+            led_worker_publish_preview(worker, NULL);
+        }
+        break;
+    case WS8211:
+        // Not supported yet
+        break;
+    case WS2812B:
+        if(command->enabled) {
+            if(!furi_hal_power_is_otg_enabled()) {
+                furi_hal_power_enable_otg();
+            }
+            if(command->ledMode != LedModeSolid) {
+                if(!worker->effectReady || !worker->hasActive ||
+                   worker->active.ledMode != command->ledMode ||
+                   worker->active.rgb != command->rgb) {
+                    worker->effectReady = led_worker_build_effect(worker, command);
+                    worker->effectStartMs = led_worker_now_ms(worker);
+                    // A new effect may cost more or less, so start again from the top
+                    ledGovernorInit(&worker->governor);
+                }
+                led_worker_render_effect(worker, command->ledMode);
+            } else {
+                ledFramebufferFill(&worker->framebuffer, command->rgb);
+            }
+            led_worker_send(worker, command->gpioPin, false, NULL);
+        }
+        break;
+    default:
+        FURI_LOG_E(TAG, "Error with selected LED type %d", command->ledType);
+        break;
+    }
+
+    worker->active = *command;
+    worker->hasActive = true;
+    led_worker_report_rate(worker);
+}
+
+static int32_t led_worker_thread(void* context) {
+    LedWorker_t* worker = context;
+    FURI_LOG_D(TAG, "LED worker started");
+
+    worker->startMs = led_worker_now_ms(worker);
+    while(true) {
+        // Sleep until something changes, when nothing is scheduled that is forever
+        uint32_t timeout = led_worker_next_wakeup_ms(worker);
+        if(timeout != FuriWaitForever) {
+            timeout = furi_ms_to_ticks(timeout);
+        }
+        uint32_t flags = furi_thread_flags_wait(LED_WORKER_FLAGS_ALL, FuriFlagWaitAny, timeout);
+        const uint32_t wakeMs = led_worker_now_ms(worker);
+        if(flags & FuriFlagError) {
+            led_worker_refresh(worker);
+            worker->busyMs += led_worker_now_ms(worker) - wakeMs;
+            continue;
+        }
+        if(flags & LedWorkerFlagStop) {
+            break;
+        }
+
+        // Take only the newest command, anything posted while we were
+        // transmitting has already been merged into it.
+        LedCommand_t command;
+        bool hasCommand = false;
+        bool previewChanged = false;
+        furi_check(furi_mutex_acquire(worker->mutex, FuriWaitForever) == FuriStatusOk);
+        if(worker->hasPending) {
+            command = worker->pending;
+            worker->hasPending = false;
+            hasCommand = true;
+        }
+        if(worker->pendingPreview != worker->preview) {
+            worker->preview = worker->pendingPreview;
+            previewChanged = true;
+        }
+        furi_mutex_release(worker->mutex);
+
+        if(previewChanged) {
+            // Catch the new preview up with whatever the strip is already showing
+            led_worker_publish_preview(worker, led_worker_shown_frame(worker));
+        }
+
+        if(hasCommand) {
+            led_worker_apply(worker, &command);
+        }
+        worker->busyMs += led_worker_now_ms(worker) - wakeMs;
+    }
+
+    FURI_LOG_I(
+        TAG,
+        "LED worker sent %lu frames, skipped %lu unchanged, busy %lu of %lu ms",
+        worker->framesSent,
+        worker->framesSkipped,
+        worker->busyMs,
+        led_worker_now_ms(worker) - worker->startMs);
+    if(worker->hasActive) {
+        led_worker_turn_off(worker, &worker->active);
+    }
+    ledPwmStopAll();
+    // Reclaim every LED buffer in one go
+    led_worker_release_arena(worker);
+    FURI_LOG_D(TAG, "LED worker stopped");
+    return 0;
+}
+
+LedWorker_t* ledWorkerAlloc() {
+    LedWorker_t* worker = malloc(sizeof(LedWorker_t));
+    worker->mutex = furi_mutex_alloc(FuriMutexTypeNormal);
+    worker->hasPending = false;
+    worker->hasActive = false;
+    worker->arenaCapacity = 0;
+    worker->rateCallback = NULL;
+    worker->rateCallbackContext = NULL;
+    worker->errorCallback = NULL;
+    worker->errorCallbackContext = NULL;
+    worker->pendingPreview = NULL;
+    worker->preview = NULL;
+    worker->arena = (LedArena_t){0};
+    worker->framebuffer = (LedFramebuffer_t){0};
+    worker->timerBuffer = NULL;
+    worker->scratch = (LedArena_t){0};
+    worker->effectReady = false;
+    worker->sentValid = false;
+    worker->clockMs = 0;
+    worker->clockCycles = DWT->CYCCNT;
+    worker->clockTick = furi_get_tick();
+    worker->lastSendMs = 0;
+    ledGovernorInit(&worker->governor);
+    worker->lastFrameMs = 0;
+    worker->reportedFps = 0;
+    worker->framesSent = 0;
+    worker->framesSkipped = 0;
+    worker->busyMs = 0;
+    worker->thread =
+        furi_thread_alloc_ex("LightUpLedWorker", LED_WORKER_STACK_SIZE, led_worker_thread, worker);
+    furi_thread_start(worker->thread);
+    return worker;
+}
+
+void ledWorkerFree(LedWorker_t* worker) {
+    furi_thread_flags_set(furi_thread_get_id(worker->thread), LedWorkerFlagStop);
+    furi_thread_join(worker->thread);
+    furi_thread_free(worker->thread);
+    furi_mutex_free(worker->mutex);
+    free(worker);
+}
+
+void ledWorkerSetRateCallback(
+    LedWorker_t* worker,
+    LedWorkerRateCallback callback,
+    void* context) {
+    furi_check(furi_mutex_acquire(worker->mutex, FuriWaitForever) == FuriStatusOk);
+    worker->rateCallback = callback;
+    worker->rateCallbackContext = context;
+    furi_mutex_release(worker->mutex);
+}
+
+void ledWorkerSetErrorCallback(
+    LedWorker_t* worker,
+    LedWorkerErrorCallback callback,
+    void* context) {
+    furi_check(furi_mutex_acquire(worker->mutex, FuriWaitForever) == FuriStatusOk);
+    worker->errorCallback = callback;
+    worker->errorCallbackContext = context;
+    furi_mutex_release(worker->mutex);
+}
+
+void ledWorkerSetPreview(LedWorker_t* worker, LedPreview_t* preview) {
+    furi_check(furi_mutex_acquire(worker->mutex, FuriWaitForever) == FuriStatusOk);
+    worker->pendingPreview = preview;
+    furi_mutex_release(worker->mutex);
+    furi_thread_flags_set(furi_thread_get_id(worker->thread), LedWorkerFlagUpdate);
+}
+
+void ledWorkerPost(LedWorker_t* worker, const LedCommand_t* command) {
+    furi_check(furi_mutex_acquire(worker->mutex, FuriWaitForever) == FuriStatusOk);
+    worker->pending = *command;
+    worker->hasPending = true;
+    furi_mutex_release(worker->mutex);
+    furi_thread_flags_set(furi_thread_get_id(worker->thread), LedWorkerFlagUpdate);
+}
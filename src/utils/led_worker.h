@@ -0,0 +1,102 @@
+#pragma once
+
+#include <furi_hal_gpio.h>
+
+#include "../main.h"
+#include "led_preview.h"
+
+/// @brief A single request for what the LEDs should currently be showing.
+/// Commands describe the full desired state, so only the newest one matters.
+typedef struct {
+    const GpioPin* gpioPin;
+    LedType ledType;
+    uint16_t ledCount;
+    LedMode ledMode;
+    bool enabled;
+    uint32_t rgb;
+    // Perceived brightness from 0 to 255, used to dim single LEDs.
+    uint8_t brightness;
+    // Resend the frame at least this often even when it has not changed, 0 to only send changes.
+    uint32_t keepAliveMs;
+} LedCommand_t;
+
+/// @brief Owns the thread that drives the LEDs so that the GUI thread
+/// never has to wait on encoding or transmission.
+typedef struct LedWorker LedWorker_t;
+
+/// @brief Called from the worker thread when the rate effects are rendered at changes.
+/// @param fps The new frame rate, or 0 when nothing is animating.
+/// @param context The context given when the callback was set.
+typedef void (*LedWorkerRateCallback)(uint32_t fps, void* context);
+
+/// @brief Problems the worker runs into while playing an effect.
+typedef enum {
+    LedWorkerErrorScriptLoad, // The effect script couldn't be read, or was rejected
+    LedWorkerErrorScriptRun, // The effect script was stopped for doing too much work
+} LedWorkerError;
+
+/// @brief Called from the worker thread when an effect can't be played.
+/// @param error What went wrong.
+/// @param context The context given when the callback was set.
+typedef void (*LedWorkerErrorCallback)(LedWorkerError error, void* context);
+
+/// @brief Allocates and starts the LED worker thread.
+/// @return The running LED worker.
+LedWorker_t* ledWorkerAlloc();
+
+/// @brief Stops the LED worker, turning off the pin and OTG power it was using.
+/// @param worker The LED worker to stop and free.
+void ledWorkerFree(LedWorker_t* worker);
+
+/// @brief Gets the size of the arena the worker needs to drive a strip. This
+/// covers every buffer used to render and send a frame.
+/// @param ledCount The number of LEDs on the strip.
+/// @param ledType The type of LEDs on the strip.
+/// @param ledMode What the strip will be showing, which decides how pixels are stored.
+/// @return The size in bytes of the LED arena.
+size_t ledWorkerRequiredMemory(uint16_t ledCount, LedType ledType, LedMode ledMode);
+
+/// @brief Checks whether the worker will have enough memory to drive a strip,
+/// taking into account the memory it would release from its current arena.
+/// @param worker The LED worker that would drive the strip.
+/// @param ledCount The number of LEDs on the strip.
+/// @param ledType The type of LEDs on the strip.
+/// @param ledMode What the strip will be showing, which decides how pixels are stored.
+/// @return Returns true if the configuration fits in the free heap.
+bool ledWorkerConfigFits(
+    LedWorker_t* worker,
+    uint16_t ledCount,
+    LedType ledType,
+    LedMode ledMode);
+
+/// @brief Posts a new desired state to the LED worker. Never blocks on the
+/// LEDs themselves; any command that has not been sent yet is replaced.
+/// @param worker The LED worker to post to.
+/// @param command The state the LEDs should be updated to.
+void ledWorkerPost(LedWorker_t* worker, const LedCommand_t* command);
+
+/// @brief Sets the callback told about frame rate changes. The callback runs on
+/// the worker thread, so it should only hand the rate off, e.g. as a custom event.
+/// @param worker The LED worker to watch.
+/// @param callback The callback to call, or NULL to stop watching.
+/// @param context Passed through to the callback.
+void ledWorkerSetRateCallback(
+    LedWorker_t* worker,
+    LedWorkerRateCallback callback,
+    void* context);
+
+/// @brief Sets the callback told when an effect can't be played. Like the rate
+/// callback, it runs on the worker thread.
+/// @param worker The LED worker to watch.
+/// @param callback The callback to call, or NULL to stop watching.
+/// @param context Passed through to the callback.
+void ledWorkerSetErrorCallback(
+    LedWorker_t* worker,
+    LedWorkerErrorCallback callback,
+    void* context);
+
+/// @brief Sets where the worker publishes what the strip is showing. Publishing
+/// never waits on whoever is reading the preview.
+/// @param worker The LED worker to watch.
+/// @param preview The preview to publish to, or NULL to stop publishing.
+void ledWorkerSetPreview(LedWorker_t* worker, LedPreview_t* preview);
@@ -0,0 +1,124 @@
+#include <gui/canvas.h>
+#include <gui/view.h>
+
+#include "led_preview_view.h"
+#include "../main.h"
+
+// How often the preview is redrawn while it is shown
+#define LED_PREVIEW_VIEW_REFRESH_MS 50
+// Cells at least this bright are drawn filled in, anything dimmer as an outline
+#define LED_PREVIEW_VIEW_THRESHOLD 16
+#define LED_PREVIEW_VIEW_COLUMNS 32
+#define LED_PREVIEW_VIEW_TOP 14
+#define LED_PREVIEW_VIEW_MAX_CELL_HEIGHT 12
+
+typedef struct {
+    LedPreview_t preview;
+    // Only exists while the view is shown, so nothing is left to free with the view.
+    FuriTimer* timer;
+    LedPreviewViewShownCallback shownCallback;
+    void* shownCallbackContext;
+} LedPreviewViewModel_t;
+
+static void led_preview_view_draw(Canvas* canvas, void* model) {
+    LedPreviewViewModel_t* previewModel = model;
+    const LedPreviewSnapshot_t* snapshot = ledPreviewRead(&previewModel->preview);
+
+    canvas_clear(canvas);
+    canvas_set_color(canvas, ColorBlack);
+    canvas_set_font(canvas, FontSecondary);
+    if(snapshot->ledCount == 0) {
+        canvas_draw_str_aligned(
+            canvas, canvas_width(canvas) / 2, 32, AlignCenter, AlignCenter, "Strip is off");
+        return;
+    }
+
+    char title[24];
+    snprintf(title, sizeof(title), "%u LEDs", snapshot->ledCount);
+    canvas_draw_str(canvas, 0, 10, title);
+
+    // Lay the cells out in rows of up to 32, as big as will fit
+    const uint16_t columns = MIN(snapshot->cellCount, LED_PREVIEW_VIEW_COLUMNS);
+    const uint16_t rows = (snapshot->cellCount + columns - 1) / columns;
+    const int32_t cellWidth = canvas_width(canvas) / columns;
+    const int32_t cellHeight = MIN(
+        (int32_t)(canvas_height(canvas) - LED_PREVIEW_VIEW_TOP) / rows,
+        LED_PREVIEW_VIEW_MAX_CELL_HEIGHT);
+    const int32_t left = (canvas_width(canvas) - cellWidth * columns) / 2;
+    for(uint16_t cell = 0; cell < snapshot->cellCount; cell++) {
+        const int32_t x = left + (cell % columns) * cellWidth;
+        const int32_t y = LED_PREVIEW_VIEW_TOP + (cell / columns) * cellHeight;
+        if(snapshot->levels[cell] >= LED_PREVIEW_VIEW_THRESHOLD) {
+            canvas_draw_box(canvas, x, y, cellWidth - 1, cellHeight - 1);
+        } else {
+            canvas_draw_frame(canvas, x, y, cellWidth - 1, cellHeight - 1);
+        }
+    }
+}
+
+static void led_preview_view_timer_callback(void* context) {
+    View* view = context;
+    // Only asks the GUI to redraw, the snapshot is picked up when it does
+    view_get_model(view);
+    view_commit_model(view, true);
+}
+
+static void led_preview_view_enter(void* context) {
+    View* view = context;
+    LedPreviewViewModel_t* model = view_get_model(view);
+    model->timer = furi_timer_alloc(led_preview_view_timer_callback, FuriTimerTypePeriodic, view);
+    furi_timer_start(model->timer, furi_ms_to_ticks(LED_PREVIEW_VIEW_REFRESH_MS));
+    LedPreviewViewShownCallback callback = model->shownCallback;
+    void* callbackContext = model->shownCallbackContext;
+    view_commit_model(view, true);
+    if(callback != NULL) {
+        callback(true, callbackContext);
+    }
+}
+
+static void led_preview_view_exit(void* context) {
+    View* view = context;
+    LedPreviewViewModel_t* model = view_get_model(view);
+    furi_timer_stop(model->timer);
+    furi_timer_free(model->timer);
+    model->timer = NULL;
+    LedPreviewViewShownCallback callback = model->shownCallback;
+    void* callbackContext = model->shownCallbackContext;
+    view_commit_model(view, false);
+    if(callback != NULL) {
+        callback(false, callbackContext);
+    }
+}
+
+View* ledPreviewViewAlloc() {
+    View* view = view_alloc();
+    view_allocate_model(view, ViewModelTypeLockFree, sizeof(LedPreviewViewModel_t));
+    LedPreviewViewModel_t* model = view_get_model(view);
+    ledPreviewInit(&model->preview);
+    model->timer = NULL;
+    model->shownCallback = NULL;
+    model->shownCallbackContext = NULL;
+    view_commit_model(view, false);
+
+    view_set_context(view, view);
+    view_set_draw_callback(view, led_preview_view_draw);
+    view_set_enter_callback(view, led_preview_view_enter);
+    view_set_exit_callback(view, led_preview_view_exit);
+    return view;
+}
+
+LedPreview_t* ledPreviewViewGetPreview(View* view) {
+    LedPreviewViewModel_t* model = view_get_model(view);
+    view_commit_model(view, false);
+    return &model->preview;
+}
+
+void ledPreviewViewSetShownCallback(
+    View* view,
+    LedPreviewViewShownCallback callback,
+    void* context) {
+    LedPreviewViewModel_t* model = view_get_model(view);
+    model->shownCallback = callback;
+    model->shownCallbackContext = context;
+    view_commit_model(view, false);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <gui/view.h>
+
+#include "../utils/led_preview.h"
+
+/// @brief Called on the GUI thread when the preview view is shown or hidden.
+/// @param shown Whether the view is now shown.
+/// @param context The context given when the callback was set.
+typedef void (*LedPreviewViewShownCallback)(bool shown, void* context);
+
+/// @brief Allocates a view that draws a live preview of the strip. It redraws
+/// on its own timer while shown, so drawing never waits on the LED worker.
+/// Free it with view_free.
+/// @return The preview view.
+View* ledPreviewViewAlloc();
+
+/// @brief Gets the preview the view draws, for the LED worker to publish to.
+/// @param view The preview view.
+/// @return The preview, which lives as long as the view.
+LedPreview_t* ledPreviewViewGetPreview(View* view);
+
+/// @brief Sets the callback told when the view is shown or hidden, so whoever
+/// publishes to the preview only has to while someone can see it.
+/// @param view The preview view.
+/// @param callback The callback to call, or NULL to stop watching.
+/// @param context Passed through to the callback.
+void ledPreviewViewSetShownCallback(
+    View* view,
+    LedPreviewViewShownCallback callback,
+    void* context);
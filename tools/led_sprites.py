@@ -0,0 +1,131 @@
+#!/usr/bin/env python3
+"""Converts the PNGs in sprites/ into LED sprites at build time.
+
+Each image becomes a LedSprite_t (see src/utils/led_sprite.h). Only opaque
+pixels are kept, grouped into runs per row. Every run is stored twice, once
+left to right and once right to left, so rows of a serpentine matrix that are
+wired backwards are a straight copy too. That way drawing a sprite on the
+device is a copy per run, with no decoding or transparency checks.
+
+Pixels are packed as R, G, B bytes like an RGB framebuffer rather than in the
+strip's G, R, B wire order, since the framebuffer is what sprites are drawn
+into and ws2812bEncode reorders the bytes as it encodes every frame anyway.
+
+Usage: led_sprites.py <sprites dir> <output .c file>
+"""
+
+import pathlib
+import re
+import sys
+
+from PIL import Image
+
+# Pixels at least this opaque are drawn, anything else is transparent.
+ALPHA_THRESHOLD = 128
+MAX_SIZE = 255
+BYTES_PER_LINE = 12
+
+
+def symbol_name(path):
+    return "led_sprite_" + re.sub(r"[^0-9a-zA-Z_]", "_", path.stem).lower()
+
+
+def convert(path):
+    image = Image.open(path).convert("RGBA")
+    width, height = image.size
+    if width > MAX_SIZE or height > MAX_SIZE:
+        raise ValueError(f"{path.name} is {width}x{height}, sprites can be at most {MAX_SIZE}x{MAX_SIZE}")
+
+    data = image.load()
+    pixels = []
+    reversed_pixels = []
+    spans = []
+    row_spans = []
+    for y in range(height):
+        row_spans.append(len(spans))
+        x = 0
+        while x < width:
+            if data[x, y][3] < ALPHA_THRESHOLD:
+                x += 1
+                continue
+            start = x
+            while x < width and data[x, y][3] >= ALPHA_THRESHOLD:
+                x += 1
+            run = [data[column, y][:3] for column in range(start, x)]
+            spans.append((start, x - start, len(pixels) // 3))
+            for pixel in run:
+                pixels.extend(pixel)
+            for pixel in reversed(run):
+                reversed_pixels.extend(pixel)
+    row_spans.append(len(spans))
+    if len(pixels) // 3 > 0xFFFF:
+        raise ValueError(f"{path.name} has too many opaque pixels")
+    return width, height, pixels, reversed_pixels, spans, row_spans
+
+
+def format_array(values):
+    lines = []
+    for i in range(0, len(values), BYTES_PER_LINE):
+        lines.append("    " + ", ".join(str(v) for v in values[i : i + BYTES_PER_LINE]) + ",")
+    return "\n".join(lines)
+
+
+def generate(sprites_dir):
+    out = [
+        "// Generated by tools/led_sprites.py from sprites/, do not edit.",
+        "#include <stddef.h>",
+        "",
+        '#include "src/utils/led_sprite.h"',
+        "",
+    ]
+    symbols = []
+    for path in sorted(pathlib.Path(sprites_dir).glob("*.png")):
+        width, height, pixels, reversed_pixels, spans, row_spans = convert(path)
+        symbol = symbol_name(path)
+        symbols.append(symbol)
+
+        if pixels:
+            out.append(f"static const uint8_t {symbol}_pixels[] = {{")
+            out.append(format_array(pixels))
+            out.append("};")
+            out.append(f"static const uint8_t {symbol}_reversed[] = {{")
+            out.append(format_array(reversed_pixels))
+            out.append("};")
+            out.append(f"static const LedSpriteSpan_t {symbol}_spans[] = {{")
+            out.extend(f"    {{{x}, {length}, {pixel}}}," for x, length, pixel in spans)
+            out.append("};")
+        out.append(f"static const uint16_t {symbol}_rows[] = {{")
+        out.append(format_array(row_spans))
+        out.append("};")
+        out.append(f"static const LedSprite_t {symbol} = {{")
+        out.append(f'    .name = "{path.stem}",')
+        out.append(f"    .width = {width},")
+        out.append(f"    .height = {height},")
+        out.append(f"    .pixels = {symbol + '_pixels' if pixels else 'NULL'},")
+        out.append(f"    .reversedPixels = {symbol + '_reversed' if pixels else 'NULL'},")
+        out.append(f"    .spans = {symbol + '_spans' if pixels else 'NULL'},")
+        out.append(f"    .rowSpans = {symbol}_rows,")
+        out.append("};")
+        out.append("")
+
+    out.append("const LedSprite_t* const ledSprites[] = {")
+    out.extend(f"    &{symbol}," for symbol in symbols)
+    if not symbols:
+        out.append("    NULL,")
+    out.append("};")
+    out.append(f"const size_t ledSpriteCount = {len(symbols)};")
+    return "\n".join(out) + "\n"
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__.strip().splitlines()[-1], file=sys.stderr)
+        return 1
+    output = pathlib.Path(sys.argv[2])
+    output.parent.mkdir(parents=True, exist_ok=True)
+    output.write_text(generate(sys.argv[1]))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
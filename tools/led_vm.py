@@ -0,0 +1,524 @@
+#!/usr/bin/env python3
+"""Compiles and verifies LED effect scripts for the app's effect VM.
+
+The compiled bytecode is run once per frame by src/utils/led_vm.c. Copy it to
+the SD card as apps_data/light_up/effect.lvm and pick the "Script" mode.
+
+Usage:
+    led_vm.py compile <script> <output .lvm>
+    led_vm.py verify <file .lvm>
+
+Scripts look like this:
+
+    # Comments start with a hash
+    palette 000000 ff4000 ffff80    # Up to 16 colors for pal() and the range ops
+    var phase                       # Variables keep their value between frames
+    phase = time / 8
+    noiserange(0, count, phase, 24) # Range ops draw a run of LEDs in one go
+    for i in 0 .. count / 10 {
+        set(i * 10, rgb(sin(phase + i * 16), 0, 0))
+    }
+
+Statements: var, assignment, for .. in a .. b, while, if/else, and the draw
+calls set(i, c), fill(start, n, c), gradient(start, n, c1, c2),
+palrange(start, n, index, step), noiserange(start, n, x, step) and
+fade(start, n, amount). Expressions use C operators and precedence, plus
+sin(x), noise(x), pal(i), rgb(r, g, b), min(a, b), max(a, b), time, count
+and color.
+"""
+
+import re
+import struct
+import sys
+
+# Must match LedVmOp in src/utils/led_vm.h. Each entry is the opcode's
+# name, how many values it pops and pushes, and how many immediate bytes follow.
+OPS = [
+    ("end", 0, 0, 0),
+    ("push8", 0, 1, 1),
+    ("push16", 0, 1, 2),
+    ("push32", 0, 1, 4),
+    ("load", 0, 1, 1),
+    ("store", 1, 0, 1),
+    ("dup", 1, 2, 0),
+    ("drop", 1, 0, 0),
+    ("swap", 2, 2, 0),
+    ("add", 2, 1, 0),
+    ("sub", 2, 1, 0),
+    ("mul", 2, 1, 0),
+    ("div", 2, 1, 0),
+    ("mod", 2, 1, 0),
+    ("and", 2, 1, 0),
+    ("or", 2, 1, 0),
+    ("xor", 2, 1, 0),
+    ("shl", 2, 1, 0),
+    ("shr", 2, 1, 0),
+    ("min", 2, 1, 0),
+    ("max", 2, 1, 0),
+    ("lt", 2, 1, 0),
+    ("eq", 2, 1, 0),
+    ("neg", 1, 1, 0),
+    ("not", 1, 1, 0),
+    ("sin", 1, 1, 0),
+    ("noise", 1, 1, 0),
+    ("time", 0, 1, 0),
+    ("count", 0, 1, 0),
+    ("color", 0, 1, 0),
+    ("pal", 1, 1, 0),
+    ("rgb", 3, 1, 0),
+    ("set", 2, 0, 0),
+    ("fill", 3, 0, 0),
+    ("gradient", 4, 0, 0),
+    ("palrange", 4, 0, 0),
+    ("noiserange", 4, 0, 0),
+    ("fade", 3, 0, 0),
+    ("jump", 0, 0, 2),
+    ("jumpifzero", 1, 0, 2),
+    ("loop", 0, 0, 4),
+]
+OPCODES = {name: code for code, (name, _, _, _) in enumerate(OPS)}
+PALETTE_OPS = {OPCODES["pal"], OPCODES["palrange"], OPCODES["noiserange"]}
+
+# Must match the limits in src/utils/led_vm.h.
+MAGIC = b"LVM1"
+HEADER_SIZE = 10
+MAX_FILE_SIZE = 1024
+MAX_STACK = 32
+MAX_VARS = 16
+MAX_PALETTE = 16
+
+# Builtins that leave a value, and how many arguments they take.
+EXPRESSION_BUILTINS = {
+    "sin": 1,
+    "noise": 1,
+    "pal": 1,
+    "rgb": 3,
+    "min": 2,
+    "max": 2,
+    "time": 0,
+    "count": 0,
+    "color": 0,
+}
+# Builtins that draw and leave nothing, and how many arguments they take.
+STATEMENT_BUILTINS = {
+    "set": 2,
+    "fill": 3,
+    "gradient": 4,
+    "palrange": 4,
+    "noiserange": 4,
+    "fade": 3,
+}
+KEYWORDS = {"var", "for", "in", "while", "if", "else", "palette"}
+
+# Binary operators from loosest to tightest binding, with the ops each compiles to.
+BINARY_LEVELS = [
+    {"|": ["or"]},
+    {"^": ["xor"]},
+    {"&": ["and"]},
+    {"==": ["eq"], "!=": ["eq", "not"]},
+    {"<": ["lt"], ">": ["swap", "lt"], "<=": ["swap", "lt", "not"], ">=": ["lt", "not"]},
+    {"<<": ["shl"], ">>": ["shr"]},
+    {"+": ["add"], "-": ["sub"]},
+    {"*": ["mul"], "/": ["div"], "%": ["mod"]},
+]
+
+TOKEN_PATTERN = re.compile(
+    r"\s*(?:(#[^\n]*)|(0x[0-9a-fA-F]+|\d+)|([A-Za-z_]\w*)|(\.\.|==|!=|<=|>=|<<|>>|[-+*/%&|^<>!=(),{}]))"
+)
+
+
+class ScriptError(Exception):
+    pass
+
+
+def tokenize(source):
+    tokens = []
+    for line_number, line in enumerate(source.splitlines(), 1):
+        words = line.split("#", 1)[0].split()
+        if words and words[0] == "palette":
+            # Colors like 00ff00 would not tokenize as numbers or names
+            if not words[1:] or not all(re.fullmatch(r"[0-9a-fA-F]{6}", word) for word in words[1:]):
+                raise ScriptError(f"line {line_number}: palette colors are written as RRGGBB")
+            tokens.append(("palette", [int(word, 16) for word in words[1:]], line_number))
+            tokens.append(("newline", None, line_number))
+            continue
+        position = 0
+        while position < len(line):
+            if line[position:].strip() == "":
+                break
+            match = TOKEN_PATTERN.match(line, position)
+            if not match:
+                raise ScriptError(f"line {line_number}: unexpected '{line[position:].strip()[0]}'")
+            position = match.end()
+            comment, number, name, symbol = match.groups()
+            if comment:
+                break
+            if number:
+                tokens.append(("number", int(number, 16 if number.startswith("0x") else 10), line_number))
+            elif name:
+                tokens.append(("name", name, line_number))
+            else:
+                tokens.append(("symbol", symbol, line_number))
+        tokens.append(("newline", None, line_number))
+    tokens.append(("eof", None, 0))
+    return tokens
+
+
+class Compiler:
+    def __init__(self, source):
+        self.tokens = tokenize(source)
+        self.position = 0
+        self.code = bytearray()
+        self.variables = {}
+        self.palette = []
+
+    # Token helpers
+
+    def peek(self):
+        return self.tokens[self.position]
+
+    def next(self):
+        token = self.tokens[self.position]
+        self.position += 1
+        return token
+
+    def error(self, message):
+        raise ScriptError(f"line {self.peek()[2]}: {message}")
+
+    def accept(self, value):
+        if self.peek()[1] == value and self.peek()[0] in ("symbol", "name"):
+            self.position += 1
+            return True
+        return False
+
+    def expect(self, value):
+        if not self.accept(value):
+            self.error(f"expected '{value}'")
+
+    def skip_newlines(self):
+        while self.peek()[0] == "newline":
+            self.position += 1
+
+    def expect_name(self):
+        kind, value, _ = self.next()
+        if kind != "name" or value in KEYWORDS:
+            self.position -= 1
+            self.error("expected a name")
+        return value
+
+    # Code emission
+
+    def emit(self, *names):
+        for name in names:
+            self.code.append(OPCODES[name])
+
+    def emit_constant(self, value):
+        value = ((value + 2**31) % 2**32) - 2**31
+        if -128 <= value < 128:
+            self.code += bytes([OPCODES["push8"]]) + struct.pack("<b", value)
+        elif -32768 <= value < 32768:
+            self.code += bytes([OPCODES["push16"]]) + struct.pack("<h", value)
+        else:
+            self.code += bytes([OPCODES["push32"]]) + struct.pack("<i", value)
+
+    def emit_variable(self, op, name):
+        if name not in self.variables:
+            self.error(f"unknown variable '{name}'")
+        self.code += bytes([OPCODES[op], self.variables[name]])
+
+    def declare(self, name):
+        if name in self.variables:
+            self.error(f"'{name}' is already declared")
+        if name in EXPRESSION_BUILTINS or name in STATEMENT_BUILTINS:
+            self.error(f"'{name}' is a builtin")
+        if len(self.variables) >= MAX_VARS:
+            self.error(f"too many variables, the most is {MAX_VARS}")
+        self.variables[name] = len(self.variables)
+
+    def emit_jump(self, op):
+        """Emits a jump to be patched later, returning where its offset goes."""
+        self.code += bytes([OPCODES[op], 0, 0])
+        return len(self.code) - 2
+
+    def patch_jump(self, offset_at, target):
+        offset = target - (offset_at + 2)
+        if not -32768 <= offset < 32768:
+            self.error("jump is too far")
+        self.code[offset_at : offset_at + 2] = struct.pack("<h", offset)
+
+    def emit_jump_to(self, op, target):
+        self.patch_jump(self.emit_jump(op), target)
+
+    # Expressions
+
+    def expression(self, level=0):
+        if level == len(BINARY_LEVELS):
+            return self.unary()
+        self.expression(level + 1)
+        while self.peek()[0] == "symbol" and self.peek()[1] in BINARY_LEVELS[level]:
+            ops = BINARY_LEVELS[level][self.next()[1]]
+            self.expression(level + 1)
+            self.emit(*ops)
+
+    def unary(self):
+        if self.accept("-"):
+            self.unary()
+            self.emit("neg")
+        elif self.accept("!"):
+            self.unary()
+            self.emit("not")
+        else:
+            self.primary()
+
+    def arguments(self, name, count):
+        if count == 0:
+            # Builtins without arguments can be written with or without brackets
+            if self.accept("("):
+                self.expect(")")
+            return
+        self.expect("(")
+        for i in range(count):
+            if i > 0:
+                self.expect(",")
+            self.expression()
+        if not self.accept(")"):
+            self.error(f"{name} takes {count} arguments")
+
+    def primary(self):
+        kind, value, _ = self.next()
+        if kind == "number":
+            self.emit_constant(value)
+        elif kind == "symbol" and value == "(":
+            self.expression()
+            self.expect(")")
+        elif kind == "name" and value in EXPRESSION_BUILTINS:
+            self.arguments(value, EXPRESSION_BUILTINS[value])
+            self.emit(value)
+        elif kind == "name" and value not in KEYWORDS:
+            self.emit_variable("load", value)
+        else:
+            self.position -= 1
+            self.error("expected a value")
+
+    # Statements
+
+    def end_of_statement(self):
+        if self.peek()[0] not in ("newline", "eof") and self.peek()[1] != "}":
+            self.error("expected the end of the line")
+
+    def block(self):
+        self.expect("{")
+        while True:
+            self.skip_newlines()
+            if self.accept("}"):
+                return
+            if self.peek()[0] == "eof":
+                self.error("expected '}'")
+            self.statement()
+
+    def statement(self):
+        kind, value, _ = self.peek()
+        if kind == "palette":
+            self.next()
+            self.palette.extend(value)
+            if len(self.palette) > MAX_PALETTE:
+                self.error(f"too many palette colors, the most is {MAX_PALETTE}")
+        elif kind != "name":
+            self.error("expected a statement")
+        elif value == "var":
+            self.next()
+            name = self.expect_name()
+            self.declare(name)
+            if self.accept("="):
+                self.expression()
+                self.emit_variable("store", name)
+        elif value == "for":
+            self.next()
+            self.for_statement()
+        elif value == "while":
+            self.next()
+            top = len(self.code)
+            self.expression()
+            exit_jump = self.emit_jump("jumpifzero")
+            self.block()
+            self.emit_jump_to("jump", top)
+            self.patch_jump(exit_jump, len(self.code))
+        elif value == "if":
+            self.next()
+            self.if_statement()
+        elif value in STATEMENT_BUILTINS:
+            self.next()
+            self.arguments(value, STATEMENT_BUILTINS[value])
+            self.emit(value)
+        else:
+            name = self.expect_name()
+            self.expect("=")
+            self.expression()
+            self.emit_variable("store", name)
+        self.end_of_statement()
+
+    def for_statement(self):
+        name = self.expect_name()
+        if name not in self.variables:
+            self.declare(name)
+        self.expect("in")
+        self.expression()
+        self.emit_variable("store", name)
+        self.expect("..")
+        # The end is worked out once, before the first iteration
+        end = f" end{len(self.code)}"
+        self.declare(end)
+        self.expression()
+        self.emit_variable("store", end)
+
+        # Check once up front, then the loop op steps and checks at the bottom
+        self.emit_variable("load", name)
+        self.emit_variable("load", end)
+        self.emit("lt")
+        exit_jump = self.emit_jump("jumpifzero")
+        top = len(self.code)
+        self.block()
+        self.code += bytes([OPCODES["loop"], self.variables[name], self.variables[end], 0, 0])
+        self.patch_jump(len(self.code) - 2, top)
+        self.patch_jump(exit_jump, len(self.code))
+
+    def if_statement(self):
+        self.expression()
+        else_jump = self.emit_jump("jumpifzero")
+        self.block()
+        if self.accept("else"):
+            end_jump = self.emit_jump("jump")
+            self.patch_jump(else_jump, len(self.code))
+            if self.accept("if"):
+                self.if_statement()
+            else:
+                self.block()
+            self.patch_jump(end_jump, len(self.code))
+        else:
+            self.patch_jump(else_jump, len(self.code))
+
+    def compile(self):
+        while True:
+            self.skip_newlines()
+            if self.peek()[0] == "eof":
+                break
+            self.statement()
+        self.emit("end")
+
+        header = MAGIC + bytes([MAX_STACK, len(self.variables), len(self.palette), 0])
+        program = header + struct.pack("<H", len(self.code))
+        for rgb in self.palette:
+            program += rgb.to_bytes(3, "big")
+        program = bytearray(program + self.code)
+        # Let the verifier work out how much stack is really needed
+        program[4] = verify(bytes(program))["stack"]
+        return bytes(program)
+
+
+def verify(program):
+    """Checks a compiled program the same way the app does when it loads one.
+
+    Returns the program's stats, raising ScriptError if the app would reject it.
+    """
+    if len(program) > MAX_FILE_SIZE:
+        raise ScriptError(f"program is {len(program)} bytes, the most is {MAX_FILE_SIZE}")
+    if len(program) < HEADER_SIZE or program[:4] != MAGIC:
+        raise ScriptError("not an effect program")
+    stack_size, var_count, palette_size, reserved = program[4:8]
+    (code_size,) = struct.unpack("<H", program[8:10])
+    if not 0 < stack_size <= MAX_STACK or var_count > MAX_VARS or palette_size > MAX_PALETTE:
+        raise ScriptError("header asks for more than the app allows")
+    if reserved != 0 or code_size == 0 or len(program) != HEADER_SIZE + palette_size * 3 + code_size:
+        raise ScriptError("header does not match the program")
+    code = program[HEADER_SIZE + palette_size * 3 :]
+
+    depths = [None] * code_size
+    starts = set()
+    pc = 0
+    depth = 0
+    max_depth = 1
+    reachable = True
+    while pc < code_size:
+        op = code[pc]
+        if op >= len(OPS):
+            raise ScriptError(f"{pc}: bad opcode {op}")
+        if reachable:
+            if depths[pc] is not None and depths[pc] != depth:
+                raise ScriptError(f"{pc}: stack depth does not match")
+            depths[pc] = depth
+        elif depths[pc] is None:
+            raise ScriptError(f"{pc}: nothing jumps here")
+        depth = depths[pc]
+        starts.add(pc)
+        reachable = True
+
+        name, pops, pushes, immediate = OPS[op]
+        following = pc + 1 + immediate
+        if following > code_size:
+            raise ScriptError(f"{pc}: {name} runs off the end of the code")
+        if depth < pops or depth - pops + pushes > stack_size:
+            raise ScriptError(f"{pc}: {name} overflows or underflows the stack")
+        depth = depth - pops + pushes
+        max_depth = max(max_depth, depth)
+
+        if name in ("load", "store") and code[pc + 1] >= var_count:
+            raise ScriptError(f"{pc}: bad variable {code[pc + 1]}")
+        if name == "loop" and max(code[pc + 1], code[pc + 2]) >= var_count:
+            raise ScriptError(f"{pc}: bad variable {max(code[pc + 1], code[pc + 2])}")
+        if op in PALETTE_OPS and palette_size == 0:
+            raise ScriptError(f"{pc}: {name} needs a palette")
+        if name in ("jump", "jumpifzero", "loop"):
+            # The offset is always the last immediate
+            (offset,) = struct.unpack("<h", code[following - 2 : following])
+            target = following + offset
+            if not 0 <= target < code_size:
+                raise ScriptError(f"{pc}: jump out of the code")
+            if target <= pc and target not in starts:
+                raise ScriptError(f"{pc}: jump into the middle of an instruction")
+            if depths[target] is not None and depths[target] != depth:
+                raise ScriptError(f"{pc}: stack depth does not match at the jump target")
+            depths[target] = depth
+            reachable = name != "jump"
+        elif name == "end":
+            reachable = False
+        pc = following
+    if reachable:
+        raise ScriptError("the code runs off the end")
+    for offset, target_depth in enumerate(depths):
+        if target_depth is not None and offset not in starts:
+            raise ScriptError(f"{offset}: jump into the middle of an instruction")
+    return {
+        "size": len(program),
+        "code": code_size,
+        "stack": max_depth,
+        "vars": var_count,
+        "palette": palette_size,
+    }
+
+
+def main():
+    try:
+        if len(sys.argv) == 4 and sys.argv[1] == "compile":
+            with open(sys.argv[2]) as source:
+                program = Compiler(source.read()).compile()
+            with open(sys.argv[3], "wb") as output:
+                output.write(program)
+        elif len(sys.argv) == 3 and sys.argv[1] == "verify":
+            with open(sys.argv[2], "rb") as source:
+                program = source.read()
+        else:
+            print(__doc__.split("\n\n")[2], file=sys.stderr)
+            return 2
+        stats = verify(program)
+        print(
+            f"{stats['size']} bytes: {stats['code']} of code, stack {stats['stack']}, "
+            f"{stats['vars']} variables, {stats['palette']} palette colors"
+        )
+        return 0
+    except ScriptError as error:
+        print(f"error: {error}", file=sys.stderr)
+        return 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())